@@ -0,0 +1,140 @@
+﻿#include "AllocationGuard.h"
+
+#ifndef NDEBUG
+#include <cassert>
+#include <cstdlib>
+#include <new>
+#ifdef _MSC_VER
+#include <malloc.h>
+#endif
+
+// Запреты считаются по потокам: BatchRunner гоняет симуляции параллельно,
+// и тик одной не должен ловить выделения в соседних
+static thread_local int forbiddenDepth = 0;
+
+NoAllocationScope::NoAllocationScope(bool enabled) : enabled(enabled) {
+    if (enabled) forbiddenDepth++;
+}
+
+NoAllocationScope::~NoAllocationScope() {
+    if (enabled) forbiddenDepth--;
+}
+
+// Глобальные operator new/delete заменяются только в отладочной сборке.
+// Файл попадает в программу вместе с Simulation::Step, который ссылается
+// на NoAllocationScope. Заменяется весь набор (размерный, nothrow,
+// выровненный), иначе часть выделений уйдет мимо проверки, а память из
+// malloc попадет в стандартный delete
+static void* Allocate(std::size_t size) {
+    assert(forbiddenDepth == 0 && "heap allocation inside Simulation::Step");
+    return std::malloc(size > 0 ? size : 1);
+}
+
+void* operator new(std::size_t size) {
+    void* memory = Allocate(size);
+    if (!memory) throw std::bad_alloc();
+    return memory;
+}
+
+void* operator new[](std::size_t size) {
+    return operator new(size);
+}
+
+void* operator new(std::size_t size, const std::nothrow_t&) noexcept {
+    return Allocate(size);
+}
+
+void* operator new[](std::size_t size, const std::nothrow_t&) noexcept {
+    return Allocate(size);
+}
+
+void operator delete(void* memory) noexcept {
+    std::free(memory);
+}
+
+void operator delete[](void* memory) noexcept {
+    std::free(memory);
+}
+
+void operator delete(void* memory, std::size_t) noexcept {
+    std::free(memory);
+}
+
+void operator delete[](void* memory, std::size_t) noexcept {
+    std::free(memory);
+}
+
+void operator delete(void* memory, const std::nothrow_t&) noexcept {
+    std::free(memory);
+}
+
+void operator delete[](void* memory, const std::nothrow_t&) noexcept {
+    std::free(memory);
+}
+
+#ifdef __cpp_aligned_new
+// Выровненные выделения (alignas больше, чем дает malloc) - только с C++17
+static void* AllocateAligned(std::size_t size, std::align_val_t alignment) {
+    assert(forbiddenDepth == 0 && "heap allocation inside Simulation::Step");
+    std::size_t align = static_cast<std::size_t>(alignment);
+    if (size == 0) size = 1;
+#ifdef _MSC_VER
+    return _aligned_malloc(size, align);
+#else
+    void* memory = nullptr;
+    if (align < sizeof(void*)) align = sizeof(void*);
+    return posix_memalign(&memory, align, size) == 0 ? memory : nullptr;
+#endif
+}
+
+static void FreeAligned(void* memory) {
+#ifdef _MSC_VER
+    _aligned_free(memory);
+#else
+    std::free(memory);
+#endif
+}
+
+void* operator new(std::size_t size, std::align_val_t alignment) {
+    void* memory = AllocateAligned(size, alignment);
+    if (!memory) throw std::bad_alloc();
+    return memory;
+}
+
+void* operator new[](std::size_t size, std::align_val_t alignment) {
+    return operator new(size, alignment);
+}
+
+void* operator new(std::size_t size, std::align_val_t alignment, const std::nothrow_t&) noexcept {
+    return AllocateAligned(size, alignment);
+}
+
+void* operator new[](std::size_t size, std::align_val_t alignment, const std::nothrow_t&) noexcept {
+    return AllocateAligned(size, alignment);
+}
+
+void operator delete(void* memory, std::align_val_t) noexcept {
+    FreeAligned(memory);
+}
+
+void operator delete[](void* memory, std::align_val_t) noexcept {
+    FreeAligned(memory);
+}
+
+void operator delete(void* memory, std::size_t, std::align_val_t) noexcept {
+    FreeAligned(memory);
+}
+
+void operator delete[](void* memory, std::size_t, std::align_val_t) noexcept {
+    FreeAligned(memory);
+}
+
+void operator delete(void* memory, std::align_val_t, const std::nothrow_t&) noexcept {
+    FreeAligned(memory);
+}
+
+void operator delete[](void* memory, std::align_val_t, const std::nothrow_t&) noexcept {
+    FreeAligned(memory);
+}
+#endif
+#endif
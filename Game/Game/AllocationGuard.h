@@ -0,0 +1,23 @@
+﻿#pragma once
+
+// Проверка "тик симуляции не выделяет память". В отладочной сборке, пока
+// жив NoAllocationScope, любой operator new на этом потоке срабатывает
+// на assert. В релизе (NDEBUG) класс пустой и ничего не стоит.
+
+class NoAllocationScope {
+public:
+#ifdef NDEBUG
+    explicit NoAllocationScope(bool) {}
+#else
+    explicit NoAllocationScope(bool enabled);
+    ~NoAllocationScope();
+#endif
+
+    NoAllocationScope(const NoAllocationScope&) = delete;
+    NoAllocationScope& operator=(const NoAllocationScope&) = delete;
+
+#ifndef NDEBUG
+private:
+    bool enabled;
+#endif
+};
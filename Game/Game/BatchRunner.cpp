@@ -0,0 +1,362 @@
+﻿// Пакетный прогон забегов без окна: N seed'ов x M наборов улучшений,
+// управляет бот, работа делится между всеми ядрами.
+//
+//   BatchRunner [--seeds N] [--first-seed S] [--threads T] [--max-time SEC]
+//               [--tick-rate HZ] [--crowd N] [--lanes N]
+//               [--upgrades 1,1,1,1,1 ...] [--difficulty FILE]
+//               [--reaction SEC] [--mistakes RATE] [--csv FILE]
+//               [--record FILE]
+//   BatchRunner --replay FILE [--lanes N] [--difficulty FILE] [--crowd N]
+//
+// Для каждого набора улучшений печатает распределения времени жизни,
+// очков, монет и причины смерти. --record сохраняет повтор первого забега
+// (первый seed, первый набор улучшений); --replay проигрывает повтор до
+// конца, сверяет итоговые очки с записанными и печатает скорость прогона -
+// для регрессионных проверок и замеров на одном и том же забеге.
+
+#include "Simulation.h"
+#include "Bot.h"
+#include "Replay.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+struct UpgradeSet {
+    int levels[upgradeCount];
+};
+
+struct RunResult {
+    uint64_t seed;
+    int upgradeSet;
+    float survivalTime;
+    int score;
+    int coins;
+    int deathCause; // Номер ObstacleType или -1, если забег дошел до лимита времени
+};
+
+struct BatchOptions {
+    int seedCount;
+    uint64_t firstSeed;
+    int threadCount;
+    float maxTime;
+    float tickRate;
+    int crowdSize;
+    std::vector<UpgradeSet> upgradeSets;
+    SimConfig config;
+    DifficultyCurve difficulty;
+    BotSettings bot;
+    std::string csvPath;
+    std::string recordPath;
+    std::string replayPath;
+
+    BatchOptions() : seedCount(1000), firstSeed(1), threadCount(0), maxTime(600.0f), tickRate(120.0f), crowdSize(0) {}
+};
+
+static bool ParseUpgradeSet(const char* text, UpgradeSet& set) {
+    for (int i = 0; i < upgradeCount; i++) {
+        char* end = nullptr;
+        long level = std::strtol(text, &end, 10);
+        if (end == text || level < 1 || level > 255) return false;
+        set.levels[i] = static_cast<int>(level);
+
+        if (i + 1 < upgradeCount) {
+            if (*end != ',') return false;
+            text = end + 1;
+        }
+        else if (*end != '\0') {
+            return false;
+        }
+    }
+    return true;
+}
+
+static void PrintUsage() {
+    std::printf(
+        "Usage: BatchRunner [options]\n"
+        "  --seeds N              seeds per upgrade set (default 1000)\n"
+        "  --first-seed S         first seed, the rest are S+1, S+2, ... (default 1)\n"
+        "  --threads T            worker threads (default: all cores)\n"
+        "  --max-time SEC         stop a run after SEC seconds of game time (default 600)\n"
+        "  --tick-rate HZ         simulation ticks per second (default 120)\n"
+        "  --crowd N              run with N crowd followers (to measure their cost)\n"
+        "  --lanes N              track width in lanes, 3 to 16 (default 3)\n"
+        "  --upgrades a,b,c,d,e   upgrade levels, may be repeated (default 1,1,1,1,1)\n"
+        "  --difficulty FILE      difficulty curve (speed and spawn intervals by distance)\n"
+        "  --reaction SEC         bot reaction time\n"
+        "  --mistakes RATE        bot lapses per second of game time\n"
+        "  --csv FILE             write every run as a CSV row\n"
+        "  --record FILE          save a replay of the first run\n"
+        "  --replay FILE          play a replay to the end and check its final score\n");
+}
+
+static bool ParseOptions(int argc, char** argv, BatchOptions& options) {
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "--help" || arg == "-h") return false;
+        if (i + 1 >= argc) {
+            std::fprintf(stderr, "Missing value for %s\n", arg.c_str());
+            return false;
+        }
+        const char* value = argv[++i];
+
+        if (arg == "--seeds") options.seedCount = std::atoi(value);
+        else if (arg == "--first-seed") options.firstSeed = std::strtoull(value, nullptr, 10);
+        else if (arg == "--threads") options.threadCount = std::atoi(value);
+        else if (arg == "--max-time") options.maxTime = static_cast<float>(std::atof(value));
+        else if (arg == "--tick-rate") options.tickRate = static_cast<float>(std::atof(value));
+        else if (arg == "--crowd") options.crowdSize = std::atoi(value);
+        else if (arg == "--lanes") options.config.laneCount = std::atoi(value);
+        else if (arg == "--difficulty") {
+            if (!LoadDifficultyCurve(value, options.difficulty)) {
+                std::fprintf(stderr, "Failed to load difficulty curve '%s'\n", value);
+                return false;
+            }
+        }
+        else if (arg == "--reaction") options.bot.reactionTime = static_cast<float>(std::atof(value));
+        else if (arg == "--mistakes") options.bot.mistakeRate = static_cast<float>(std::atof(value));
+        else if (arg == "--csv") options.csvPath = value;
+        else if (arg == "--record") options.recordPath = value;
+        else if (arg == "--replay") options.replayPath = value;
+        else if (arg == "--upgrades") {
+            UpgradeSet set;
+            if (!ParseUpgradeSet(value, set)) {
+                std::fprintf(stderr, "Bad upgrade set '%s', expected %d comma-separated levels\n", value, upgradeCount);
+                return false;
+            }
+            options.upgradeSets.push_back(set);
+        }
+        else {
+            std::fprintf(stderr, "Unknown option %s\n", arg.c_str());
+            return false;
+        }
+    }
+
+    if (options.seedCount <= 0 || options.tickRate <= 0.0f) return false;
+    if (options.config.laneCount < minLaneCount || options.config.laneCount > maxLaneCount) {
+        std::fprintf(stderr, "Lane count must be %d to %d\n", minLaneCount, maxLaneCount);
+        return false;
+    }
+    if (options.upgradeSets.empty()) {
+        UpgradeSet set;
+        for (int i = 0; i < upgradeCount; i++) set.levels[i] = 1;
+        options.upgradeSets.push_back(set);
+    }
+    if (options.threadCount <= 0) {
+        options.threadCount = std::max(1, static_cast<int>(std::thread::hardware_concurrency()));
+    }
+    return true;
+}
+
+// recorder (если задан) пишет нажатия бота в повтор
+static RunResult RunOne(Simulation& sim, Bot& bot, const BatchOptions& options, uint64_t seed, int upgradeSet,
+    ReplayRecorder* recorder = nullptr) {
+    const UpgradeSet& set = options.upgradeSets[upgradeSet];
+    for (int i = 0; i < upgradeCount; i++) {
+        sim.SetUpgradeLevel(static_cast<UpgradeType>(i), set.levels[i]);
+    }
+    sim.Reset(seed);
+    sim.ResetCoinsCollected();
+    bot.Reset(seed);
+    if (recorder) recorder->Begin(sim, static_cast<uint16_t>(options.tickRate));
+
+    const float dt = 1.0f / options.tickRate;
+    const uint32_t maxTicks = static_cast<uint32_t>(options.maxTime * options.tickRate);
+    while (!sim.IsGameOver() && sim.GetTick() < maxTicks) {
+        InputState input = bot.Think(sim, dt);
+        if (recorder) recorder->Record(sim.GetTick(), input);
+        sim.Step(dt, input);
+    }
+    if (recorder) recorder->Finish(sim.GetTick(), sim.GetScore());
+
+    RunResult result;
+    result.seed = seed;
+    result.upgradeSet = upgradeSet;
+    result.survivalTime = sim.GetTick() * dt;
+    result.score = sim.GetScore();
+    result.coins = sim.GetCoinsCollected();
+    result.deathCause = sim.IsGameOver() ? static_cast<int>(sim.GetDeathCause()) : -1;
+    return result;
+}
+
+// Задания раздаются через атомарный счетчик, у каждого потока своя
+// симуляция, результаты пишутся в свои ячейки - общих блокировок нет
+static void RunBatch(const BatchOptions& options, std::vector<RunResult>& results) {
+    const size_t jobCount = static_cast<size_t>(options.seedCount) * options.upgradeSets.size();
+    results.resize(jobCount);
+    std::atomic<size_t> nextJob(0);
+
+    auto worker = [&]() {
+        Simulation sim(options.config);
+        sim.SetDifficultyCurve(options.difficulty);
+        sim.SetCrowdSize(options.crowdSize);
+        Bot bot(options.bot);
+        for (size_t job = nextJob++; job < jobCount; job = nextJob++) {
+            int upgradeSet = static_cast<int>(job / options.seedCount);
+            uint64_t seed = options.firstSeed + job % options.seedCount;
+            results[job] = RunOne(sim, bot, options, seed, upgradeSet);
+        }
+    };
+
+    std::vector<std::thread> threads;
+    for (int i = 1; i < options.threadCount; i++) {
+        threads.emplace_back(worker);
+    }
+    worker();
+    for (auto& thread : threads) {
+        thread.join();
+    }
+}
+
+static bool RecordFirstRun(const BatchOptions& options) {
+    Simulation sim(options.config);
+    sim.SetDifficultyCurve(options.difficulty);
+    sim.SetCrowdSize(options.crowdSize);
+    Bot bot(options.bot);
+    ReplayRecorder recorder;
+    RunOne(sim, bot, options, options.firstSeed, 0, &recorder);
+    return SaveReplay(recorder.GetReplay(), options.recordPath);
+}
+
+// Проигрывает повтор с частотой тиков из файла. Код возврата 0, только
+// если итоговые очки совпали с записанными
+static int PlayReplay(const BatchOptions& options) {
+    Replay replay;
+    if (!LoadReplay(options.replayPath, replay) || replay.tickRate == 0) {
+        std::fprintf(stderr, "Failed to load replay %s\n", options.replayPath.c_str());
+        return 1;
+    }
+    if (replay.difficultyHash != options.difficulty.GetHash()) {
+        std::fprintf(stderr, "Replay was recorded with another difficulty curve (see --difficulty)\n");
+        return 1;
+    }
+
+    Simulation sim(options.config);
+    sim.SetDifficultyCurve(options.difficulty);
+    sim.SetCrowdSize(options.crowdSize);
+    ReplayPlayer player;
+    player.Start(replay, sim);
+    sim.ResetCoinsCollected();
+
+    const float dt = 1.0f / replay.tickRate;
+    auto start = std::chrono::steady_clock::now();
+    while (!player.IsFinished(sim.GetTick())) {
+        sim.Step(dt, player.NextInput(sim.GetTick()));
+    }
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    bool matches = sim.GetScore() == static_cast<int>(replay.finalScore);
+    std::printf("Replay seed %llu, %u ticks at %u Hz: score %d, recorded %u - %s\n",
+        static_cast<unsigned long long>(replay.seed), replay.tickCount, static_cast<unsigned>(replay.tickRate),
+        sim.GetScore(), replay.finalScore, matches ? "OK" : "MISMATCH");
+    std::printf("%.3f s (%.0f simulated seconds per wall second)\n",
+        seconds, replay.tickCount * dt / seconds);
+    return matches ? 0 : 1;
+}
+
+// Перцентиль по отсортированной выборке
+template <typename T>
+static T Percentile(const std::vector<T>& sorted, float p) {
+    size_t index = static_cast<size_t>(p * (sorted.size() - 1) + 0.5f);
+    return sorted[std::min(index, sorted.size() - 1)];
+}
+
+template <typename T>
+static void PrintDistribution(const char* name, std::vector<T> values) {
+    std::sort(values.begin(), values.end());
+    double sum = 0.0;
+    for (T value : values) sum += value;
+
+    std::printf("  %-14s mean %10.1f  p10 %10.1f  p50 %10.1f  p90 %10.1f  max %10.1f\n", name,
+        sum / values.size(),
+        static_cast<double>(Percentile(values, 0.1f)),
+        static_cast<double>(Percentile(values, 0.5f)),
+        static_cast<double>(Percentile(values, 0.9f)),
+        static_cast<double>(values.back()));
+}
+
+static void PrintReport(const BatchOptions& options, const std::vector<RunResult>& results) {
+    for (size_t set = 0; set < options.upgradeSets.size(); set++) {
+        std::vector<float> survival;
+        std::vector<int> scores;
+        std::vector<int> coins;
+        int deaths[obstacleTypeCount] = { 0 };
+        int timeouts = 0;
+
+        for (const auto& result : results) {
+            if (result.upgradeSet != static_cast<int>(set)) continue;
+            survival.push_back(result.survivalTime);
+            scores.push_back(result.score);
+            coins.push_back(result.coins);
+            if (result.deathCause < 0) timeouts++;
+            else deaths[result.deathCause]++;
+        }
+
+        const int* levels = options.upgradeSets[set].levels;
+        std::printf("Upgrades %d,%d,%d,%d,%d: %zu runs\n", levels[0], levels[1], levels[2], levels[3], levels[4], survival.size());
+        PrintDistribution("survival, s", survival);
+        PrintDistribution("score", scores);
+        PrintDistribution("coins", coins);
+
+        std::printf("  death cause   ");
+        for (int i = 0; i < obstacleTypeCount; i++) {
+            std::printf(" %s %.1f%%", obstacleArchetypes[i].name, 100.0 * deaths[i] / survival.size());
+        }
+        std::printf(" TIMEOUT %.1f%%\n", 100.0 * timeouts / survival.size());
+    }
+}
+
+static bool WriteCsv(const std::string& path, const BatchOptions& options, const std::vector<RunResult>& results) {
+    std::ofstream file(path);
+    if (!file) return false;
+
+    file << "seed,upgrades,survival_time,score,coins,death_cause\n";
+    for (const auto& result : results) {
+        const int* levels = options.upgradeSets[result.upgradeSet].levels;
+        file << result.seed << ',' << levels[0] << '-' << levels[1] << '-' << levels[2] << '-' << levels[3] << '-' << levels[4]
+            << ',' << result.survivalTime << ',' << result.score << ',' << result.coins << ','
+            << (result.deathCause < 0 ? "TIMEOUT" : obstacleArchetypes[result.deathCause].name) << '\n';
+    }
+    return static_cast<bool>(file);
+}
+
+int main(int argc, char** argv) {
+    BatchOptions options;
+    if (!ParseOptions(argc, argv, options)) {
+        PrintUsage();
+        return 1;
+    }
+    if (!options.replayPath.empty()) {
+        return PlayReplay(options);
+    }
+
+    std::printf("Running %d seeds x %zu upgrade sets on %d threads\n",
+        options.seedCount, options.upgradeSets.size(), options.threadCount);
+
+    std::vector<RunResult> results;
+    auto start = std::chrono::steady_clock::now();
+    RunBatch(options, results);
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    PrintReport(options, results);
+
+    double simulatedSeconds = 0.0;
+    for (const auto& result : results) simulatedSeconds += result.survivalTime;
+    std::printf("%zu runs in %.2f s (%.0f simulated seconds per wall second)\n",
+        results.size(), seconds, simulatedSeconds / seconds);
+
+    if (!options.csvPath.empty() && !WriteCsv(options.csvPath, options, results)) {
+        std::fprintf(stderr, "Failed to write %s\n", options.csvPath.c_str());
+        return 1;
+    }
+    if (!options.recordPath.empty() && !RecordFirstRun(options)) {
+        std::fprintf(stderr, "Failed to write %s\n", options.recordPath.c_str());
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,92 @@
+﻿#include "Bot.h"
+
+// Номер потока бота не пересекается с потоками симуляции
+static const uint64_t botRandomStream = 100;
+
+void Bot::Reset(uint64_t seed) {
+    random.Seed(seed, botRandomStream);
+    mistakeTimer = 0.0f;
+}
+
+bool Bot::FindNextObstacle(const Simulation& sim, int lane, float maxTime, Obstacle& nearest) const {
+    const Player& player = sim.GetPlayer();
+    Scalar playerFront = player.position.z - player.size.z / 2;
+
+    Scalar speed = sim.GetGameSpeed();
+
+    // Смотрим только очередь своей полосы, сколько бы полос ни было. Она
+    // идет от ближнего к дальнему - первое еще не задевшее игрока и есть
+    // ближайшее; перед ним в голове бывают только те, что сейчас рядом с ним
+    const RingBuffer<LaneObstacle>& laneObstacles = sim.GetLaneObstacles(lane);
+    for (size_t i = 0; i < laneObstacles.GetCount(); i++) {
+        Obstacle obstacle;
+        if (!sim.FindObstacle(laneObstacles[i].id, obstacle)) continue;
+
+        // Расстояние от передней грани игрока до задней грани препятствия
+        Scalar distance = playerFront - (obstacle.position.z - GetArchetype(obstacle.type).size.z / 2);
+        if (distance < 0.0f) continue;
+        if (distance > speed * maxTime) return false;
+
+        nearest = obstacle;
+        return true;
+    }
+    return false;
+}
+
+// В полосе нет ничего, что нельзя пройти прыжком или перекатом
+bool Bot::IsLaneSafe(const Simulation& sim, int lane, bool canRoll) const {
+    Obstacle obstacle;
+    if (!FindNextObstacle(sim, lane, settings.laneLookAhead, obstacle)) return true;
+    const ObstacleArchetype& archetype = GetArchetype(obstacle.type);
+    if (archetype.avoid & AVOID_JUMP) return true;
+    return (archetype.avoid & AVOID_ROLL) && canRoll;
+}
+
+InputState Bot::Think(const Simulation& sim, float dt) {
+    InputState input = { false, false, false, false };
+    const Player& player = sim.GetPlayer();
+
+    if (mistakeTimer > 0.0f) {
+        mistakeTimer -= dt;
+        return input;
+    }
+    if (random.Float() < settings.mistakeRate * dt) {
+        mistakeTimer = settings.mistakeTime;
+        return input;
+    }
+    if (sim.IsGameOver()) return input;
+
+    int lane = player.targetLane;
+    Obstacle obstacle;
+    if (!FindNextObstacle(sim, lane, settings.laneLookAhead, obstacle)) return input;
+
+    bool canRoll = !player.isJumping && !player.isRolling && !sim.IsTimerActive(player.rollCooldownTimer);
+    const ObstacleArchetype& archetype = GetArchetype(obstacle.type);
+    bool mustDodge = archetype.avoid == AVOID_NONE ||
+        (!(archetype.avoid & AVOID_JUMP) && !canRoll && !player.isRolling);
+
+    if (mustDodge) {
+        // Уходим в безопасную соседнюю полосу, с краю - сначала к центру
+        int lastLane = sim.GetLaneCount() - 1;
+        bool leftSafe = lane > 0 && IsLaneSafe(sim, lane - 1, canRoll);
+        bool rightSafe = lane < lastLane && IsLaneSafe(sim, lane + 1, canRoll);
+        if (leftSafe && (lane == lastLane || !rightSafe)) input.left = true;
+        else if (rightSafe) input.right = true;
+        // Обе соседние заняты - с края все равно уходим к центру, оттуда ближе к свободной
+        else if (lane == 0) input.right = true;
+        else if (lane == lastLane) input.left = true;
+        return input;
+    }
+
+    // Прыжок или перекат - в последний момент, чтобы не закончились раньше удара
+    Scalar timeToHit = (player.position.z - player.size.z / 2 - (obstacle.position.z + archetype.size.z / 2)) / sim.GetGameSpeed();
+    if (timeToHit > settings.reactionTime) return input;
+
+    if (archetype.avoid & AVOID_JUMP) {
+        input.jump = !player.isJumping && !player.isRolling;
+    }
+    else {
+        input.roll = canRoll;
+    }
+    return input;
+}
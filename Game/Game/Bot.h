@@ -0,0 +1,39 @@
+﻿#pragma once
+
+#include "Simulation.h"
+#include "Random.h"
+
+// Простой бот для прогонов без игрока: смотрит на ближайшее препятствие
+// в своей полосе и прыгает, катится или уходит в соседнюю полосу.
+// Ошибки и время реакции задаются настройками, случайность - из своего
+// потока, поэтому один и тот же seed дает один и тот же забег.
+
+struct BotSettings {
+    float reactionTime;  // За сколько секунд до удара бот начинает действовать
+    float laneLookAhead; // Насколько далеко (в секундах) оценивается соседняя полоса
+    float mistakeRate;   // Сколько раз в секунду (в среднем) бот "зевает"
+    float mistakeTime;   // Сколько секунд длится такой промах - ввода нет
+
+    BotSettings() : reactionTime(0.3f), laneLookAhead(0.8f), mistakeRate(0.05f), mistakeTime(0.6f) {}
+};
+
+class Bot {
+public:
+    Bot() : mistakeTimer(0.0f) {}
+    explicit Bot(const BotSettings& settings) : settings(settings), mistakeTimer(0.0f) {}
+
+    // Вызывается после sim.Reset(seed)
+    void Reset(uint64_t seed);
+
+    // Ввод для ближайшего sim.Step(dt, ...)
+    InputState Think(const Simulation& sim, float dt);
+
+private:
+    BotSettings settings;
+    Random random;
+    float mistakeTimer;
+
+    // Ближайшее препятствие в полосе впереди игрока (false, если его нет)
+    bool FindNextObstacle(const Simulation& sim, int lane, float maxTime, Obstacle& nearest) const;
+    bool IsLaneSafe(const Simulation& sim, int lane, bool canRoll) const;
+};
@@ -0,0 +1,72 @@
+﻿#include "CollisionScheduler.h"
+#include <algorithm>
+
+// std::push_heap строит max-кучу - сравнение "позже" дает минимум наверху
+static bool EntersLater(const CollisionEvent& a, const CollisionEvent& b) {
+    return a.enterDistance > b.enterDistance;
+}
+
+static bool IsOrderedBefore(const CollisionEvent& a, const CollisionEvent& b) {
+    if (a.kind != b.kind) return a.kind < b.kind;
+    return a.id < b.id;
+}
+
+void CollisionScheduler::Reserve(size_t pending, size_t dueCapacity) {
+    heap.reserve(pending);
+    due.reserve(dueCapacity);
+}
+
+void CollisionScheduler::Clear() {
+    heap.clear();
+    due.clear();
+}
+
+void CollisionScheduler::Schedule(CollisionKind kind, uint32_t id, Distance enterDistance, Distance exitDistance) {
+    CollisionEvent event;
+    event.enterDistance = enterDistance;
+    event.exitDistance = exitDistance;
+    event.id = id;
+    event.kind = kind;
+
+    heap.push_back(event);
+    std::push_heap(heap.begin(), heap.end(), EntersLater);
+}
+
+void CollisionScheduler::MakeDue(CollisionKind kind, uint32_t id, Distance exitDistance) {
+    CollisionEvent event;
+    event.enterDistance = exitDistance;
+    event.exitDistance = exitDistance;
+    event.id = id;
+    event.kind = kind;
+    AddDue(event);
+}
+
+// Объектов в зоне игрока единицы - линейный поиск дешевле любого индекса
+void CollisionScheduler::AddDue(const CollisionEvent& event) {
+    for (auto& existing : due) {
+        if (existing.kind == event.kind && existing.id == event.id) {
+            existing.exitDistance = std::max(existing.exitDistance, event.exitDistance);
+            return;
+        }
+    }
+    due.push_back(event);
+}
+
+const std::vector<CollisionEvent>& CollisionScheduler::Advance(Distance from, Distance to) {
+    due.erase(std::remove_if(due.begin(), due.end(),
+        [from](const CollisionEvent& e) { return e.exitDistance < from; }), due.end());
+
+    while (!heap.empty() && heap.front().enterDistance <= to) {
+        std::pop_heap(heap.begin(), heap.end(), EntersLater);
+        CollisionEvent event = heap.back();
+        heap.pop_back();
+
+        // Проскочил зону целиком еще до этого тика - проверять нечего
+        if (event.exitDistance >= from) {
+            AddDue(event);
+        }
+    }
+
+    std::sort(due.begin(), due.end(), IsOrderedBefore);
+    return due;
+}
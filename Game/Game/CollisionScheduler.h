@@ -0,0 +1,58 @@
+﻿#pragma once
+
+#include "SimMath.h"
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Планировщик столкновений. Все объекты мира едут по Z с общей скоростью,
+// поэтому момент, когда объект дойдет до игрока, известен уже при спавне -
+// в единицах пройденного пути (Simulation::GetDistance), а не в тиках:
+// скорость меняется по кривой сложности, а путь - нет. Объекты лежат в
+// min-куче по пути входа в зону игрока; за тик из нее достаются только
+// те, чей отрезок [вход, выход] задевает путь этого тика. Остальные
+// вообще не проверяются, сколько бы их ни было на трассе.
+
+// Препятствия идут в очередях полос (Simulation::TrackLane), здесь -
+// подбираемые предметы
+enum class CollisionKind : uint8_t {
+    COIN,
+    POWER_UP
+};
+
+struct CollisionEvent {
+    Distance enterDistance; // Путь, на котором объект входит в зону игрока
+    Distance exitDistance;  // и выходит из нее
+    uint32_t id;          // Id объекта (Coin::id, PowerUp::id)
+    CollisionKind kind;
+};
+
+class CollisionScheduler {
+public:
+    CollisionScheduler() {}
+
+    // pending - сколько объектов может ждать в куче, due - сколько
+    // одновременно в зоне игрока
+    void Reserve(size_t pending, size_t due);
+    void Clear();
+
+    void Schedule(CollisionKind kind, uint32_t id, Distance enterDistance, Distance exitDistance);
+
+    // Объект сошел с общей скорости (магнит) - проверять его сразу, пока
+    // не выйдет из зоны. Повторный вызов только продлевает срок
+    void MakeDue(CollisionKind kind, uint32_t id, Distance exitDistance);
+
+    // Путь тика [from, to]: достает из кучи наступившие события, убирает
+    // прошедшие. Возвращает события тика по порядку (вид, затем id) -
+    // тот же порядок, что и полный перебор векторов
+    const std::vector<CollisionEvent>& Advance(Distance from, Distance to);
+
+    size_t GetPendingCount() const { return heap.size(); }
+    size_t GetDueCount() const { return due.size(); }
+
+private:
+    std::vector<CollisionEvent> heap; // Куча с минимумом enterDistance наверху
+    std::vector<CollisionEvent> due;  // Объекты в зоне игрока
+
+    void AddDue(const CollisionEvent& event);
+};
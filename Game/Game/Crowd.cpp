@@ -0,0 +1,58 @@
+﻿#include "Crowd.h"
+#include <algorithm>
+
+// Ряды по 10 в шахматном порядке, первый - сразу за компаньоном
+static const int rowSize = 10;
+static const Scalar columnSpacing = 0.45f;
+static const Scalar rowSpacing = 0.6f;
+static const Scalar firstRowDistance = 4.5f;
+
+// История хранит центр игрока (высота 2, в перекате 1) - переводим в центр
+// последователя той же опоры
+static const Scalar standingOffsetY = 0.6f - 1.0f;
+static const Scalar rollingOffsetY = 0.3f - 0.5f;
+
+void Crowd::Resize(int count) {
+    size = std::max(0, std::min(count, static_cast<int>(maxSize)));
+
+    offsetX.resize(size);
+    behind.resize(size);
+    x.assign(size, 0.0f);
+    y.assign(size, 0.0f);
+    z.assign(size, 0.0f);
+    previousX.assign(size, 0.0f);
+    previousY.assign(size, 0.0f);
+    previousZ.assign(size, 0.0f);
+    rolling.assign(size, 0);
+
+    for (int i = 0; i < size; i++) {
+        int row = i / rowSize;
+        int column = i % rowSize;
+        Scalar stagger = (row % 2) ? columnSpacing / 2 : Scalar(0.0f);
+        offsetX[i] = (Scalar(column) - Scalar(rowSize - 1) / 2) * columnSpacing + stagger;
+        behind[i] = firstRowDistance + Scalar(row) * rowSpacing;
+    }
+}
+
+Scalar Crowd::GetMaxDistance() const {
+    return size > 0 ? behind[size - 1] : Scalar(0.0f);
+}
+
+void Crowd::SavePreviousState() {
+    std::copy(x.begin(), x.end(), previousX.begin());
+    std::copy(y.begin(), y.end(), previousY.begin());
+    std::copy(z.begin(), z.end(), previousZ.begin());
+}
+
+void Crowd::Update(const Trajectory& history, Scalar playerZ, Scalar ticksPerUnit, Scalar minX, Scalar maxX) {
+    for (int i = 0; i < size; i++) {
+        uint32_t delay = static_cast<uint32_t>(static_cast<int>(behind[i] * ticksPerUnit));
+        const TrajectorySample& sample = history.Sample(delay);
+
+        Scalar followerX = sample.x + offsetX[i];
+        x[i] = std::min(std::max(followerX, minX), maxX);
+        y[i] = sample.y + (sample.isRolling ? rollingOffsetY : standingOffsetY);
+        z[i] = playerZ + behind[i];
+        rolling[i] = sample.isRolling ? 1 : 0;
+    }
+}
@@ -0,0 +1,61 @@
+﻿#pragma once
+
+#include "SimMath.h"
+#include "Trajectory.h"
+#include <cstdint>
+#include <vector>
+
+// Режим "забег толпой": сотни последователей бегут за игроком рядами.
+// Как и компаньон, своей физики у них нет - каждый читает общую историю
+// игрока (Trajectory) со своей задержкой, поэтому стоимость последователя -
+// одна выборка из кольца. Поля хранятся раздельными массивами (SoA):
+// цикл обновления идет по плотным массивам без ветвлений, а отрисовка
+// собирает из них матрицы для одного инстансного вызова.
+
+// Размер последователя (стоя); в перекате высота вдвое меньше
+const Vec3 crowdFollowerSize = { 0.6f, 1.2f, 0.6f };
+
+class Crowd {
+public:
+    static const int maxSize = 1000;
+
+    Crowd() : size(0) {}
+
+    // Расставляет count последователей рядами за игроком (0 - режим выключен).
+    // Память выделяется здесь, Update ее не выделяет
+    void Resize(int count);
+    int GetSize() const { return size; }
+
+    // Насколько последний ряд отстает от игрока - столько истории нужно
+    Scalar GetMaxDistance() const;
+
+    void SavePreviousState();
+
+    // ticksPerUnit - тиков истории на единицу дистанции при текущей
+    // скорости мира; minX/maxX - края трассы
+    void Update(const Trajectory& history, Scalar playerZ, Scalar ticksPerUnit, Scalar minX, Scalar maxX);
+
+    const Scalar* GetX() const { return x.data(); }
+    const Scalar* GetY() const { return y.data(); }
+    const Scalar* GetZ() const { return z.data(); }
+    const Scalar* GetPreviousX() const { return previousX.data(); }
+    const Scalar* GetPreviousY() const { return previousY.data(); }
+    const Scalar* GetPreviousZ() const { return previousZ.data(); }
+    const uint8_t* GetRolling() const { return rolling.data(); }
+
+private:
+    int size;
+
+    // Расстановка - не меняется во время забега
+    std::vector<Scalar> offsetX; // Смещение от игрока поперек трассы
+    std::vector<Scalar> behind;  // Отставание от игрока по Z
+
+    // Состояние на текущем и предыдущем тике
+    std::vector<Scalar> x;
+    std::vector<Scalar> y;
+    std::vector<Scalar> z;
+    std::vector<Scalar> previousX;
+    std::vector<Scalar> previousY;
+    std::vector<Scalar> previousZ;
+    std::vector<uint8_t> rolling;
+};
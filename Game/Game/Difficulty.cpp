@@ -0,0 +1,127 @@
+﻿#include "Difficulty.h"
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <sstream>
+
+// Прежде скорость росла на 1/1000 за очко, а очки шли со скоростью 60 в
+// секунду: v(t) = 5 + 0.06t. По дистанции это v(d) = sqrt(25 + 0.12d)
+static const DifficultyPoint defaultPoints[] = {
+    {    0.0f, {  5.0f, 1.5f, 2.0f, 8.0f } },
+    {  250.0f, {  7.4f, 1.5f, 2.0f, 8.0f } },
+    {  500.0f, {  9.2f, 1.5f, 2.0f, 8.0f } },
+    { 1000.0f, { 12.0f, 1.5f, 2.0f, 8.0f } },
+    { 2000.0f, { 16.3f, 1.5f, 2.0f, 8.0f } },
+    { 4000.0f, { 22.5f, 1.5f, 2.0f, 8.0f } },
+    { 8000.0f, { 31.4f, 1.5f, 2.0f, 8.0f } }
+};
+
+DifficultyCurve::DifficultyCurve()
+    : points(std::begin(defaultPoints), std::end(defaultPoints)) {}
+
+bool DifficultyCurve::SetPoints(const std::vector<DifficultyPoint>& newPoints) {
+    if (newPoints.empty()) return false;
+
+    for (size_t i = 0; i < newPoints.size(); i++) {
+        const DifficultyLevel& level = newPoints[i].level;
+        if (level.speed <= 0.0f || level.obstacleSpawnInterval <= 0.0f ||
+            level.coinSpawnInterval <= 0.0f || level.powerUpSpawnInterval <= 0.0f) {
+            return false;
+        }
+        if (i > 0 && newPoints[i].distance <= newPoints[i - 1].distance) {
+            return false;
+        }
+    }
+
+    points = newPoints;
+    return true;
+}
+
+// Между точками скорость линейна - минимум всегда в одной из точек
+Scalar DifficultyCurve::GetMinSpeed() const {
+    Scalar speed = points.front().level.speed;
+    for (const auto& point : points) {
+        speed = std::min(speed, point.level.speed);
+    }
+    return speed;
+}
+
+// Биты значения зависят от арифметики сборки, но повтор из другой
+// арифметики и так не читается (ReplayNumberFormat)
+template <typename T>
+static void HashValue(uint64_t& hash, const T& value) {
+    unsigned char bytes[sizeof(T)];
+    std::memcpy(bytes, &value, sizeof(T));
+    for (unsigned char byte : bytes) {
+        hash ^= byte;
+        hash *= 1099511628211ull;
+    }
+}
+
+uint64_t DifficultyCurve::GetHash() const {
+    uint64_t hash = 14695981039346656037ull;
+    for (const auto& point : points) {
+        HashValue(hash, point.distance);
+        HashValue(hash, point.level.speed);
+        HashValue(hash, point.level.obstacleSpawnInterval);
+        HashValue(hash, point.level.coinSpawnInterval);
+        HashValue(hash, point.level.powerUpSpawnInterval);
+    }
+    return hash;
+}
+
+static Scalar Lerp(Scalar a, Scalar b, Scalar t) {
+    return a + (b - a) * t;
+}
+
+DifficultyLevel DifficultyCurve::Evaluate(Distance distance) const {
+    if (distance <= points.front().distance) return points.front().level;
+    if (distance >= points.back().distance) return points.back().level;
+
+    // Точек единицы - линейный поиск дешевле бинарного
+    size_t next = 1;
+    while (points[next].distance < distance) next++;
+
+    const DifficultyPoint& a = points[next - 1];
+    const DifficultyPoint& b = points[next];
+    Scalar t = static_cast<Scalar>((distance - a.distance) / (b.distance - a.distance));
+
+    DifficultyLevel level;
+    level.speed = Lerp(a.level.speed, b.level.speed, t);
+    level.obstacleSpawnInterval = Lerp(a.level.obstacleSpawnInterval, b.level.obstacleSpawnInterval, t);
+    level.coinSpawnInterval = Lerp(a.level.coinSpawnInterval, b.level.coinSpawnInterval, t);
+    level.powerUpSpawnInterval = Lerp(a.level.powerUpSpawnInterval, b.level.powerUpSpawnInterval, t);
+    return level;
+}
+
+bool ParseDifficultyCurve(const std::string& text, DifficultyCurve& curve) {
+    std::vector<DifficultyPoint> points;
+    std::istringstream lines(text);
+    std::string line;
+
+    while (std::getline(lines, line)) {
+        size_t first = line.find_first_not_of(" \t\r");
+        if (first == std::string::npos || line[first] == '#') continue;
+
+        std::istringstream fields(line);
+        // Читаем во float и переводим в числа симуляции один раз здесь
+        float distance, speed, obstacleInterval, coinInterval, powerUpInterval;
+        if (!(fields >> distance >> speed >> obstacleInterval >> coinInterval >> powerUpInterval)) {
+            return false;
+        }
+        DifficultyPoint point = { distance, { speed, obstacleInterval, coinInterval, powerUpInterval } };
+        points.push_back(point);
+    }
+
+    return curve.SetPoints(points);
+}
+
+bool LoadDifficultyCurve(const std::string& path, DifficultyCurve& curve) {
+    std::ifstream file(path);
+    if (!file) return false;
+
+    std::stringstream text;
+    text << file.rdbuf();
+    return ParseDifficultyCurve(text.str(), curve);
+}
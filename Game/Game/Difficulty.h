@@ -0,0 +1,49 @@
+﻿#pragma once
+
+#include "SimMath.h"
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Кривая сложности: скорость мира и интервалы спавна в зависимости от
+// пройденной дистанции. Считается один раз за тик, все системы читают
+// готовое значение. Между точками таблицы значения интерполируются
+// линейно, за последней точкой остаются постоянными.
+
+struct DifficultyLevel {
+    Scalar speed;                 // Скорость мира (единиц в секунду)
+    Scalar obstacleSpawnInterval; // Секунды между препятствиями
+    Scalar coinSpawnInterval;
+    Scalar powerUpSpawnInterval;
+};
+
+struct DifficultyPoint {
+    Distance distance;
+    DifficultyLevel level;
+};
+
+class DifficultyCurve {
+public:
+    // Встроенная кривая: повторяет прежний разгон "+1 к скорости за 1000 очков"
+    DifficultyCurve();
+
+    // Точки должны идти по возрастанию дистанции, значения - положительные.
+    // При ошибке кривая не меняется
+    bool SetPoints(const std::vector<DifficultyPoint>& newPoints);
+    const std::vector<DifficultyPoint>& GetPoints() const { return points; }
+
+    DifficultyLevel Evaluate(Distance distance) const;
+    Scalar GetMinSpeed() const; // Медленнее мир не едет нигде на кривой
+    // FNV-1a по битам всех точек: повтор хранит его, чтобы не играть
+    // запись на чужой кривой
+    uint64_t GetHash() const;
+
+private:
+    std::vector<DifficultyPoint> points;
+};
+
+// Текстовый формат для дизайнеров: по строке на точку,
+//   distance speed obstacleInterval coinInterval powerUpInterval
+// пустые строки и строки с '#' в начале пропускаются
+bool ParseDifficultyCurve(const std::string& text, DifficultyCurve& curve);
+bool LoadDifficultyCurve(const std::string& path, DifficultyCurve& curve);
@@ -0,0 +1,283 @@
+﻿#include "Entities.h"
+#include <cmath>
+
+// Анимация вращения усилений - по пройденному пути, а не по времени:
+// 2 рад/с на стартовой скорости мира 5
+static const Scalar powerUpSpinPerUnit = 0.4f;
+
+// Корзины монет: длина по пути и число списков (степень двойки). 64
+// корзины по 2 - вдвое длиннее трассы от спавна до ухода
+static const int32_t coinBucketCount = 64;
+static const uint32_t noSlot = static_cast<uint32_t>(-1);
+
+#ifdef GAME_FIXED_POINT
+// Длина корзины 2 = 2^(16+1) в Q16.16: номер - сдвиг сырого пути без
+// перехода в плавающую точку (сдвиг арифметический, округляет вниз)
+static const int coinBucketShift = Fixed::fractionBits + 1;
+
+static int64_t CoinBucketKey(Distance path) {
+    return path.raw >> coinBucketShift;
+}
+#else
+static const double coinBucketLength = 2.0;
+
+static int64_t CoinBucketKey(Distance path) {
+    return static_cast<int64_t>(std::floor(path / coinBucketLength));
+}
+#endif
+
+static int32_t CoinBucketList(Distance origin) {
+    return static_cast<int32_t>(CoinBucketKey(origin) & (coinBucketCount - 1));
+}
+
+size_t EntityColumns::Find(uint32_t entityId) const {
+    // Id от головы к хвосту возрастают - бинарный поиск по индексам кольца
+    size_t low = 0;
+    size_t high = count;
+    while (low < high) {
+        size_t middle = (low + high) / 2;
+        if (id[Slot(middle)] < entityId) low = middle + 1;
+        else high = middle;
+    }
+    if (low == count || id[Slot(low)] != entityId) return npos;
+    return active[Slot(low)] ? low : npos;
+}
+
+// Голова кольца - самый старый объект, то есть ближайший к краю трассы:
+// пока он не ушел, не ушли и остальные
+size_t EntityColumns::Despawn(Scalar limit) {
+    size_t removed = 0;
+    while (count > 0) {
+        if (active[head]) {
+            if (static_cast<Scalar>(scroll - origin[head]) <= limit) break;
+            removed++;
+        }
+        else {
+            inactiveCount--;
+        }
+        head = (head + 1) & mask;
+        count--;
+    }
+    return removed;
+}
+
+size_t EntityColumns::ReserveColumns(size_t capacity) {
+    size_t size = 1;
+    while (size < capacity) size <<= 1;
+
+    id.assign(size, 0);
+    x.assign(size, 0.0f);
+    y.assign(size, 0.0f);
+    origin.assign(size, Distance());
+    active.assign(size, 0);
+    mask = size - 1;
+    ClearColumns();
+    return size;
+}
+
+void EntityColumns::ClearColumns() {
+    head = 0;
+    count = 0;
+    inactiveCount = 0;
+}
+
+size_t EntityColumns::AddRow(uint32_t entityId, Vec3 position) {
+    if (count == GetCapacity()) return npos;
+
+    size_t slot = Slot(count);
+    id[slot] = entityId;
+    x[slot] = position.x;
+    y[slot] = position.y;
+    origin[slot] = scroll - position.z;
+    active[slot] = 1;
+    count++;
+    return slot;
+}
+
+void ObstacleStore::Reserve(size_t capacity) {
+    size_t slots = ReserveColumns(capacity);
+    lane.resize(slots);
+    type.resize(slots);
+}
+
+void ObstacleStore::Clear() {
+    ClearColumns();
+}
+
+void ObstacleStore::Resize(size_t rows) {
+    if (rows > GetCapacity()) Reserve(rows);
+    ResizeColumns(rows);
+}
+
+size_t ObstacleStore::Add(uint32_t entityId, Vec3 position, int obstacleLane, ObstacleType obstacleType) {
+    size_t slot = AddRow(entityId, position);
+    if (slot == npos) return npos;
+
+    lane[slot] = static_cast<uint8_t>(obstacleLane);
+    type[slot] = obstacleType;
+    return count - 1;
+}
+
+Obstacle ObstacleStore::Get(size_t i) const {
+    size_t slot = Slot(i);
+    Obstacle obstacle;
+    obstacle.id = id[slot];
+    obstacle.position = GetPosition(i);
+    obstacle.previousPosition = GetPreviousPosition(i);
+    obstacle.lane = lane[slot];
+    obstacle.active = active[slot] != 0;
+    obstacle.type = type[slot];
+    return obstacle;
+}
+
+void CoinStore::Reserve(size_t capacity) {
+    size_t slots = ReserveColumns(capacity);
+    previousX.resize(slots);
+    previousOrigin.resize(slots);
+    bucketHead.resize(coinBucketCount);
+    bucketNext.resize(slots);
+    bucketPrevious.resize(slots);
+    bucket.resize(slots);
+    ClearBuckets();
+    moved = false;
+}
+
+void CoinStore::Clear() {
+    ClearColumns();
+    ClearBuckets();
+    moved = false;
+}
+
+void CoinStore::Resize(size_t rows) {
+    if (rows > GetCapacity()) Reserve(rows);
+    ResizeColumns(rows);
+    moved = false;
+}
+
+size_t CoinStore::Add(uint32_t entityId, Vec3 position) {
+    size_t slot = AddRow(entityId, position);
+    if (slot == npos) return npos;
+
+    previousX[slot] = position.x;
+    previousOrigin[slot] = origin[slot];
+    Unlink(slot); // Ячейка могла остаться в списке от снятой монеты
+    Link(slot);
+    return count - 1;
+}
+
+void CoinStore::Deactivate(size_t i) {
+    EntityColumns::Deactivate(i);
+    Unlink(Slot(i));
+}
+
+void CoinStore::FindInRange(Scalar zLow, Scalar zHigh, std::vector<size_t>& out) const {
+    out.clear();
+
+    // Z = scroll - origin: окно по Z - окно по пути. Запас в корзину с
+    // каждой стороны - на округление Z при чтении
+    int64_t first = CoinBucketKey(scroll - zHigh) - 1;
+    int64_t last = CoinBucketKey(scroll - zLow) + 1;
+    if (last - first >= coinBucketCount) {
+        first = 0;
+        last = coinBucketCount - 1;
+    }
+
+    for (int64_t key = first; key <= last; key++) {
+        for (uint32_t slot = bucketHead[key & (coinBucketCount - 1)]; slot != noSlot; slot = bucketNext[slot]) {
+            size_t index = (slot - head) & mask;
+            if (index < count && active[slot]) out.push_back(index);
+        }
+    }
+    std::sort(out.begin(), out.end());
+}
+
+void CoinStore::ClearBuckets() {
+    std::fill(bucketHead.begin(), bucketHead.end(), noSlot);
+    std::fill(bucket.begin(), bucket.end(), -1);
+}
+
+void CoinStore::RebuildBuckets() {
+    ClearBuckets();
+    for (size_t i = 0; i < count; i++) {
+        if (IsActive(i)) Link(Slot(i));
+    }
+}
+
+void CoinStore::Link(size_t slot) {
+    int32_t list = CoinBucketList(origin[slot]);
+    uint32_t next = bucketHead[list];
+    bucketNext[slot] = next;
+    bucketPrevious[slot] = noSlot;
+    if (next != noSlot) bucketPrevious[next] = static_cast<uint32_t>(slot);
+    bucketHead[list] = static_cast<uint32_t>(slot);
+    bucket[slot] = list;
+}
+
+void CoinStore::Unlink(size_t slot) {
+    int32_t list = bucket[slot];
+    if (list < 0) return;
+
+    uint32_t next = bucketNext[slot];
+    uint32_t previous = bucketPrevious[slot];
+    if (previous != noSlot) bucketNext[previous] = next;
+    else bucketHead[list] = next;
+    if (next != noSlot) bucketPrevious[next] = previous;
+    bucket[slot] = -1;
+}
+
+void CoinStore::Rebucket(size_t slot) {
+    if (CoinBucketList(origin[slot]) == bucket[slot]) return;
+    Unlink(slot);
+    Link(slot);
+}
+
+void CoinStore::SavePreviousState() {
+    EntityColumns::SavePreviousState();
+    if (moved) {
+        CopyRows(x, previousX);
+        CopyRows(origin, previousOrigin);
+        moved = false;
+    }
+}
+
+Coin CoinStore::Get(size_t i) const {
+    Coin coin;
+    coin.id = GetId(i);
+    coin.position = GetPosition(i);
+    coin.previousPosition = GetPreviousPosition(i);
+    coin.active = IsActive(i);
+    return coin;
+}
+
+void PowerUpStore::Reserve(size_t capacity) {
+    type.resize(ReserveColumns(capacity));
+}
+
+void PowerUpStore::Clear() {
+    ClearColumns();
+}
+
+void PowerUpStore::Resize(size_t rows) {
+    if (rows > GetCapacity()) Reserve(rows);
+    ResizeColumns(rows);
+}
+
+size_t PowerUpStore::Add(uint32_t entityId, Vec3 position, PowerUpType powerUpType) {
+    size_t slot = AddRow(entityId, position);
+    if (slot == npos) return npos;
+
+    type[slot] = powerUpType;
+    return count - 1;
+}
+
+PowerUp PowerUpStore::Get(size_t i) const {
+    size_t slot = Slot(i);
+    PowerUp powerUp;
+    powerUp.id = id[slot];
+    powerUp.position = GetPosition(i);
+    powerUp.previousPosition = GetPreviousPosition(i);
+    powerUp.active = active[slot] != 0;
+    powerUp.type = type[slot];
+    powerUp.rotation = powerUp.position.z * powerUpSpinPerUnit;
+    return powerUp;
+}
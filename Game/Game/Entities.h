@@ -0,0 +1,337 @@
+﻿#pragma once
+
+#include "SimMath.h"
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Объекты трассы (препятствия, монеты, усиления) хранятся столбцами (SoA):
+// каждое поле - свой плотный массив. Все объекты едут к игроку с общей
+// скоростью мира, поэтому Z не хранится и не сдвигается каждый тик:
+// хранилище знает общий путь мира (scroll), а объект - путь, при котором
+// он стоял бы в Z = 0 (origin). Z = scroll - origin считается при чтении,
+// а состояние объекта после спавна не меняется (кроме монет под
+// магнитом). Порядок в столбцах - порядок спавна: id возрастают, удаление
+// порядок не меняет, поэтому объект по id ищется бинарным поиском.
+// Прежний построчный сдвиг Z (с SSE2-веткой) убран вместе со столбцом Z:
+// тик пишет одно число на хранилище, а уход смотрит только голову кольца,
+// так что проходов по всем строкам, которые стоило бы векторизовать, нет.
+//
+// Объекты одного вида появляются у дальнего края трассы и уходят у
+// ближнего в том же порядке (FIFO), поэтому столбцы - кольца постоянной
+// емкости: спавн пишет за хвост, уход снимает строки с головы, и выход за
+// трассу - сравнение головы кольца. Память выделяется только в Reserve -
+// во время забега хранилища ее не трогают.
+
+// Типы препятствий
+enum class ObstacleType {
+    JUMP_OVER,    // Можно перепрыгнуть
+    DUCK_UNDER,   // Можно пригнуться
+    WALL,         // Нельзя пройти
+    LOW_BARRIER   // Низкий барьер - нельзя перепрыгнуть, можно пригнуться
+};
+
+const int obstacleTypeCount = 4;
+
+// Как пройти препятствие, не меняя полосы (биты ObstacleArchetype::avoid)
+enum ObstacleAvoid : uint8_t {
+    AVOID_NONE = 0,
+    AVOID_JUMP = 1, // Прыжком (без переката)
+    AVOID_ROLL = 2  // Перекатом (без прыжка)
+};
+
+// Все, что определяется типом препятствия. Таблица общая для симуляции,
+// бота и отрисовки, поэтому у объекта хранится только тип. Цвет - для
+// куба без текстуры; текстура зависит от локации и выбирается при отрисовке
+struct ObstacleArchetype {
+    const char* name; // Для отчетов BatchRunner
+    Vec3 size;
+    bool canLandOn;   // Можно ли приземлиться сверху
+    uint8_t avoid;    // Биты ObstacleAvoid
+    uint8_t color[4]; // RGBA
+};
+
+constexpr ObstacleArchetype obstacleArchetypes[obstacleTypeCount] = {
+    { "JUMP_OVER", { 1.0f, 1.0f, 1.0f }, true, AVOID_JUMP, { 80, 80, 80, 255 } },
+    { "DUCK_UNDER", { 1.0f, 1.0f, 1.0f }, false, AVOID_ROLL, { 127, 106, 79, 255 } }, // Такая же высота как JUMP_OVER
+    { "WALL", { 1.0f, 3.0f, 1.0f }, false, AVOID_NONE, { 190, 33, 55, 255 } },
+    { "LOW_BARRIER", { 1.0f, 2.5f, 1.0f }, false, AVOID_ROLL, { 150, 75, 0, 255 } } // Выше - перепрыгнуть нельзя
+};
+
+inline const ObstacleArchetype& GetArchetype(ObstacleType type) {
+    return obstacleArchetypes[static_cast<int>(type)];
+}
+
+// Типы усилений
+enum class PowerUpType {
+    SPEED_BOOST,      // Увеличение скорости
+    INVINCIBILITY,    // Неуязвимость
+    MAGNET,           // Магнит для монет
+    DOUBLE_POINTS     // Двойные очки
+};
+
+// Объекты целиком - копии строк столбцов для отрисовки, бота и редких
+// проверок. Размер и правила препятствия - в GetArchetype(type)
+struct Obstacle {
+    uint32_t id; // Порядковый номер спавна
+    Vec3 position;
+    Vec3 previousPosition;
+    int lane;
+    bool active;
+    ObstacleType type;
+};
+
+// Монеты (движутся со скоростью мира)
+struct Coin {
+    uint32_t id;
+    Vec3 position;
+    Vec3 previousPosition;
+    bool active;
+};
+
+struct PowerUp {
+    uint32_t id;
+    Vec3 position;
+    Vec3 previousPosition;
+    bool active;
+    PowerUpType type;
+    Scalar rotation; // Для анимации вращения
+};
+
+// Столбцы, общие для всех видов объектов. X и Y у объектов не меняются
+// (кроме X монет под магнитом), предыдущее положение - то же, но на пути
+// прошлого тика. Индексы в методах - порядковые от головы кольца
+// (0..GetCount()-1). Объект, подобранный посреди кольца, остается
+// неактивной строкой, пока до него не дойдет голова
+class EntityColumns {
+public:
+    static const size_t npos = static_cast<size_t>(-1);
+
+    EntityColumns() : head(0), count(0), mask(0), inactiveCount(0), scroll(0), previousScroll(0) {}
+
+    size_t GetCapacity() const { return id.size(); }
+    size_t GetCount() const { return count; } // Вместе с еще не снятыми неактивными
+    size_t GetActiveCount() const { return count - inactiveCount; }
+    bool IsActive(size_t i) const { return active[Slot(i)] != 0; }
+    void Deactivate(size_t i) {
+        size_t slot = Slot(i);
+        if (active[slot]) inactiveCount++;
+        active[slot] = 0;
+    }
+
+    uint32_t GetId(size_t i) const { return id[Slot(i)]; }
+    Vec3 GetPosition(size_t i) const {
+        size_t slot = Slot(i);
+        return { x[slot], y[slot], static_cast<Scalar>(scroll - origin[slot]) };
+    }
+    Vec3 GetPreviousPosition(size_t i) const {
+        size_t slot = Slot(i);
+        return { x[slot], y[slot], static_cast<Scalar>(previousScroll - origin[slot]) };
+    }
+
+    // Индекс активного объекта по id или npos
+    size_t Find(uint32_t entityId) const;
+
+    // Путь мира, на котором считаются позиции. Сдвиг всех объектов за
+    // тик - одна запись, а не запись в каждый
+    Distance GetScroll() const { return scroll; }
+    void Scroll(Distance newScroll) { scroll = newScroll; }
+    void SavePreviousState() { previousScroll = scroll; }
+    // Путь мира без сдвига за тик - после Reset и загрузки снимка прошлое
+    // положение совпадает с текущим (первый же Step его перезапишет)
+    void ResetScroll(Distance value) {
+        scroll = value;
+        previousScroll = value;
+    }
+
+    // Снимает с головы кольца неактивные и ушедшие дальше limit по Z.
+    // Возвращает, сколько активных ушло
+    size_t Despawn(Scalar limit);
+
+protected:
+    std::vector<uint32_t> id;
+    std::vector<Scalar> x;
+    std::vector<Scalar> y;
+    std::vector<Distance> origin; // Путь мира, при котором объект в Z = 0
+    std::vector<uint8_t> active;
+    size_t head;
+    size_t count;
+    size_t mask;
+    size_t inactiveCount;
+    Distance scroll;
+    Distance previousScroll;
+
+    size_t Slot(size_t i) const { return (head + i) & mask; }
+
+    // Емкость округляется вверх до степени двойки, содержимое сбрасывается.
+    // Возвращает итоговую емкость - под нее наследник растит свои столбцы
+    size_t ReserveColumns(size_t capacity);
+    void ClearColumns();
+    // Ячейка для нового объекта за хвостом или npos, если кольцо полно
+    size_t AddRow(uint32_t entityId, Vec3 position);
+    // Чтение снимка: строки ложатся с начала столбцов
+    void ResizeColumns(size_t newCount) {
+        head = 0;
+        count = newCount;
+    }
+
+    // Копия занятой части кольца (одним или двумя отрезками)
+    template <typename T>
+    void CopyRows(const std::vector<T>& from, std::vector<T>& to) const {
+        size_t first = std::min(count, GetCapacity() - head);
+        std::copy(from.begin() + head, from.begin() + head + first, to.begin() + head);
+        std::copy(from.begin(), from.begin() + (count - first), to.begin());
+    }
+
+    template <typename Archive, typename T>
+    void SerializeColumn(Archive& archive, std::vector<T>& column) {
+        for (size_t i = 0; i < count; i++) archive(column[Slot(i)]);
+    }
+
+    // Путь мира в снимок не пишется - он равен Simulation::distance, и
+    // после чтения его задает Simulation (ResetScroll)
+    template <typename Archive>
+    void SerializeColumns(Archive& archive) {
+        SerializeColumn(archive, id);
+        SerializeColumn(archive, x);
+        SerializeColumn(archive, y);
+        SerializeColumn(archive, origin);
+        SerializeColumn(archive, active);
+        if (archive.IsReading()) {
+            inactiveCount = static_cast<size_t>(std::count(active.begin(), active.begin() + count, 0));
+        }
+    }
+};
+
+// Байт на объект в снимке - для проверки счетчиков при чтении
+const size_t serializedEntityBytes = sizeof(uint32_t) + 2 * sizeof(Scalar) + sizeof(Distance) + 1;
+
+class ObstacleStore : public EntityColumns {
+public:
+    void Reserve(size_t capacity);
+    void Clear();
+    // Индекс нового объекта или npos, если хранилище полно
+    size_t Add(uint32_t entityId, Vec3 position, int lane, ObstacleType type);
+
+    Obstacle Get(size_t i) const;
+    int GetLane(size_t i) const { return lane[Slot(i)]; }
+    ObstacleType GetType(size_t i) const { return type[Slot(i)]; }
+    const ObstacleArchetype& GetArchetype(size_t i) const { return ::GetArchetype(type[Slot(i)]); }
+
+    template <typename Archive>
+    void Serialize(Archive& archive) {
+        uint32_t rows = static_cast<uint32_t>(GetCount());
+        archive.Count(rows, serializedEntityBytes + 1 + sizeof(ObstacleType));
+        if (archive.IsReading()) Resize(rows);
+        SerializeColumns(archive);
+        SerializeColumn(archive, lane);
+        SerializeColumn(archive, type);
+    }
+
+private:
+    std::vector<uint8_t> lane;
+    std::vector<ObstacleType> type;
+
+    void Resize(size_t rows);
+};
+
+// Монеты под магнитом - единственные объекты, которые меняют X и Z после
+// спавна. Их прошлое положение хранится отдельно и догоняет текущее в
+// SavePreviousState, только если какую-то монету двигали.
+//
+// Для магнита монеты разложены по корзинам вдоль трассы (грубая фаза):
+// корзина - отрезок пути origin, а он у монеты меняется только в MoveTo,
+// так что корзины правятся при спавне, сборе и притяжении, а не каждый тик
+class CoinStore : public EntityColumns {
+public:
+    CoinStore() : moved(false) {}
+
+    void Reserve(size_t capacity);
+    void Clear();
+    size_t Add(uint32_t entityId, Vec3 position);
+
+    Coin Get(size_t i) const;
+    Vec3 GetPreviousPosition(size_t i) const {
+        size_t slot = Slot(i);
+        return { previousX[slot], y[slot], static_cast<Scalar>(previousScroll - previousOrigin[slot]) };
+    }
+    void SavePreviousState();
+
+    // Монету притянул магнит (Simulation::UpdateCoins): новое положение на
+    // пути newScroll
+    void MoveTo(size_t i, Scalar newX, Scalar newZ, Distance newScroll) {
+        size_t slot = Slot(i);
+        x[slot] = newX;
+        origin[slot] = newScroll - newZ;
+        moved = true;
+        Rebucket(slot);
+    }
+
+    void Deactivate(size_t i);
+
+    // Индексы активных монет, у которых Z может лежать в [zLow, zHigh] (и
+    // немного соседних), по порядку кольца. out очищается; памяти под
+    // GetCapacity() индексов ему хватает всегда. Точная проверка - у
+    // вызывающего
+    void FindInRange(Scalar zLow, Scalar zHigh, std::vector<size_t>& out) const;
+
+    template <typename Archive>
+    void Serialize(Archive& archive) {
+        uint32_t rows = static_cast<uint32_t>(GetCount());
+        archive.Count(rows, serializedEntityBytes);
+        if (archive.IsReading()) Resize(rows);
+        SerializeColumns(archive);
+        if (archive.IsReading()) {
+            // Прошлое положение и корзины в снимок не пишутся
+            CopyRows(x, previousX);
+            CopyRows(origin, previousOrigin);
+            RebuildBuckets();
+        }
+    }
+
+private:
+    std::vector<Scalar> previousX;
+    std::vector<Distance> previousOrigin;
+    bool moved; // previousX/previousOrigin отстают от x/origin
+
+    // Корзины - кольцо из coinBucketCount двусвязных списков через столбцы
+    // строк (без выделения памяти). Далекие по пути корзины делят список -
+    // это лишь лишние кандидаты. Строка, снятая с головы кольца, остается в
+    // списке, пока ее ячейку не займет новая монета
+    std::vector<uint32_t> bucketHead;
+    std::vector<uint32_t> bucketNext;
+    std::vector<uint32_t> bucketPrevious;
+    std::vector<int32_t> bucket; // Список строки или -1
+
+    void Resize(size_t rows);
+    void ClearBuckets();
+    void RebuildBuckets();
+    void Link(size_t slot);
+    void Unlink(size_t slot);
+    void Rebucket(size_t slot);
+};
+
+class PowerUpStore : public EntityColumns {
+public:
+    void Reserve(size_t capacity);
+    void Clear();
+    size_t Add(uint32_t entityId, Vec3 position, PowerUpType type);
+
+    PowerUp Get(size_t i) const;
+    PowerUpType GetType(size_t i) const { return type[Slot(i)]; }
+
+    template <typename Archive>
+    void Serialize(Archive& archive) {
+        uint32_t rows = static_cast<uint32_t>(GetCount());
+        archive.Count(rows, serializedEntityBytes + sizeof(PowerUpType));
+        if (archive.IsReading()) Resize(rows);
+        SerializeColumns(archive);
+        SerializeColumn(archive, type);
+    }
+
+private:
+    std::vector<PowerUpType> type;
+
+    void Resize(size_t rows);
+};
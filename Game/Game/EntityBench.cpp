@@ -0,0 +1,191 @@
+﻿// Стресс-режим хранения объектов трассы: N препятствий (до 100k) едут по
+// трассе, ушедшие за игрока тут же заменяются новыми у дальнего края.
+// Сравнивает столбцы ObstacleStore (Z выводится из общего пути мира,
+// уход - снятие с головы кольца) с прежней раскладкой - вектором полных
+// структур, сдвигом по одной и remove_if. В обеих раскладках за тик еще
+// проходит чтение всех объектов, как у отрисовки: положение между
+// прошлым и текущим тиком.
+//
+//   EntityBench [--ticks N] [--counts 1000,10000,100000]
+//
+// Печатает время тика (сдвиг, уход, спавн и проход чтения) и время на
+// объект для обеих раскладок.
+
+#include "Entities.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+static const float spawnZ = -30.0f;
+static const float despawnZ = 15.0f;
+static const float tickRate = 120.0f;
+static const float speed = 10.0f;
+
+// Раскладка до перехода на столбцы: все поля объекта подряд
+struct LegacyObstacle {
+    uint32_t id;
+    Vec3 position;
+    Vec3 previousPosition;
+    Vec3 size;
+    int lane;
+    bool active;
+    ObstacleType type;
+    bool canLandOn;
+};
+
+static Vec3 SpawnPosition(uint32_t id, size_t count, size_t index) {
+    // Первые count объектов - равномерно по трассе от ближнего края (уходят
+    // в порядке спавна, как в игре), дальше - у дальнего края
+    float z = index < count ? despawnZ - (despawnZ - spawnZ) * (index + 1) / count : spawnZ;
+    return { static_cast<float>(static_cast<int>(id % 3) - 1) * 4.0f, 0.5f, z };
+}
+
+static const float renderAlpha = 0.5f;
+
+struct BenchResult {
+    double seconds;
+    double checksum; // Чтобы компилятор не выбросил работу
+};
+
+// Сумма z, прочитанных проходами отрисовки, - тоже против выбрасывания
+static volatile double drawnZ = 0.0;
+
+static float InterpolateZ(Scalar previous, Scalar current) {
+    return ToFloat(previous) + (ToFloat(current) - ToFloat(previous)) * renderAlpha;
+}
+
+static BenchResult RunLegacy(size_t count, int ticks) {
+    std::vector<LegacyObstacle> obstacles;
+    obstacles.reserve(count);
+    uint32_t nextId = 0;
+    auto spawn = [&](size_t index) {
+        LegacyObstacle obstacle;
+        obstacle.id = nextId++;
+        obstacle.position = SpawnPosition(obstacle.id, count, index);
+        obstacle.previousPosition = obstacle.position;
+        obstacle.size = { 1.0f, 1.0f, 1.0f };
+        obstacle.lane = static_cast<int>(obstacle.id % 3);
+        obstacle.active = true;
+        obstacle.type = ObstacleType::JUMP_OVER;
+        obstacle.canLandOn = true;
+        obstacles.push_back(obstacle);
+    };
+    for (size_t i = 0; i < count; i++) spawn(i);
+
+    const float dz = speed / tickRate;
+    auto start = std::chrono::steady_clock::now();
+    for (int tick = 0; tick < ticks; tick++) {
+        for (auto& obstacle : obstacles) obstacle.previousPosition = obstacle.position;
+        for (auto& obstacle : obstacles) {
+            if (obstacle.active) {
+                obstacle.position.z += dz;
+                if (obstacle.position.z > despawnZ) obstacle.active = false;
+            }
+        }
+        obstacles.erase(std::remove_if(obstacles.begin(), obstacles.end(),
+            [](const LegacyObstacle& o) { return !o.active; }), obstacles.end());
+        while (obstacles.size() < count) spawn(count);
+
+        float drawn = 0.0f;
+        for (const auto& obstacle : obstacles) {
+            drawn += InterpolateZ(obstacle.previousPosition.z, obstacle.position.z);
+        }
+        drawnZ = drawnZ + drawn;
+    }
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    double checksum = 0.0;
+    for (const auto& obstacle : obstacles) checksum += ToFloat(obstacle.position.z);
+    return { seconds, checksum };
+}
+
+static BenchResult RunColumns(size_t count, int ticks) {
+    ObstacleStore obstacles;
+    obstacles.Reserve(count);
+    uint32_t nextId = 0;
+    auto spawn = [&](size_t index) {
+        uint32_t id = nextId++;
+        return obstacles.Add(id, SpawnPosition(id, count, index),
+            static_cast<int>(id % 3), ObstacleType::JUMP_OVER) != EntityColumns::npos;
+    };
+    for (size_t i = 0; i < count; i++) spawn(i);
+
+    const float dz = speed / tickRate;
+    Distance scroll = obstacles.GetScroll();
+    auto start = std::chrono::steady_clock::now();
+    for (int tick = 0; tick < ticks; tick++) {
+        obstacles.SavePreviousState();
+        scroll += dz;
+        obstacles.Scroll(scroll);
+        obstacles.Despawn(despawnZ);
+        while (obstacles.GetActiveCount() < count && spawn(count)) {}
+
+        float drawn = 0.0f;
+        for (size_t i = 0; i < obstacles.GetCount(); i++) {
+            if (obstacles.IsActive(i)) {
+                drawn += InterpolateZ(obstacles.GetPreviousPosition(i).z, obstacles.GetPosition(i).z);
+            }
+        }
+        drawnZ = drawnZ + drawn;
+    }
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    double checksum = 0.0;
+    for (size_t i = 0; i < obstacles.GetCount(); i++) {
+        if (obstacles.IsActive(i)) checksum += ToFloat(obstacles.GetPosition(i).z);
+    }
+    return { seconds, checksum };
+}
+
+static bool ParseCounts(const char* text, std::vector<size_t>& counts) {
+    counts.clear();
+    while (*text) {
+        char* end = nullptr;
+        long value = std::strtol(text, &end, 10);
+        if (end == text || value <= 0) return false;
+        counts.push_back(static_cast<size_t>(value));
+        if (*end == ',') end++;
+        else if (*end != '\0') return false;
+        text = end;
+    }
+    return !counts.empty();
+}
+
+int main(int argc, char** argv) {
+    int ticks = 2000;
+    std::vector<size_t> counts = { 1000, 10000, 100000 };
+
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "--ticks" && i + 1 < argc) ticks = std::atoi(argv[++i]);
+        else if (arg == "--counts" && i + 1 < argc && ParseCounts(argv[i + 1], counts)) i++;
+        else {
+            std::printf("Usage: EntityBench [--ticks N] [--counts 1000,10000,100000]\n");
+            return 1;
+        }
+    }
+    if (ticks <= 0) return 1;
+
+    std::printf("%d ticks, speed %.0f at %.0f Hz\n", ticks, speed, tickRate);
+    std::printf("%10s %16s %16s %12s %12s\n", "entities", "AoS us/tick", "SoA us/tick", "AoS ns/ent", "SoA ns/ent");
+    for (size_t count : counts) {
+        BenchResult legacy = RunLegacy(count, ticks);
+        BenchResult columns = RunColumns(count, ticks);
+        // Старая схема копит z каждого объекта во float, новая выводит его
+        // из общего пути - расхождение только в округлении
+        if (std::fabs(legacy.checksum - columns.checksum) > 0.01 * count) {
+            std::fprintf(stderr, "Layouts disagree at %zu entities\n", count);
+            return 1;
+        }
+
+        double legacyTick = legacy.seconds * 1e6 / ticks;
+        double columnsTick = columns.seconds * 1e6 / ticks;
+        std::printf("%10zu %16.2f %16.2f %12.2f %12.2f\n", count, legacyTick, columnsTick,
+            legacyTick * 1e3 / count, columnsTick * 1e3 / count);
+    }
+    return 0;
+}
@@ -0,0 +1,42 @@
+﻿#include "EntityRegistry.h"
+
+void EntityRegistry::Reserve(size_t capacity) {
+    generations.reserve(capacity);
+    freeIndices.reserve(capacity);
+}
+
+void EntityRegistry::Clear() {
+    // Свободные ячейки тоже получают новое поколение - оно еще никому не
+    // выдано, так что мертвым дескрипторам это не вредит
+    freeIndices.clear();
+    for (size_t index = generations.size(); index > 0; index--) {
+        uint32_t& generation = generations[index - 1];
+        if (++generation == 0) generation = 1;
+        freeIndices.push_back(static_cast<uint32_t>(index - 1));
+    }
+    aliveCount = 0;
+}
+
+EntityHandle EntityRegistry::Create() {
+    uint32_t index;
+    if (!freeIndices.empty()) {
+        index = freeIndices.back();
+        freeIndices.pop_back();
+    }
+    else {
+        index = static_cast<uint32_t>(generations.size());
+        generations.push_back(1);
+    }
+    aliveCount++;
+    return { index, generations[index] };
+}
+
+void EntityRegistry::Destroy(EntityHandle entity) {
+    if (!IsAlive(entity)) return;
+
+    // Поколение 0 зарезервировано за пустым дескриптором
+    uint32_t& generation = generations[entity.index];
+    if (++generation == 0) generation = 1;
+    freeIndices.push_back(entity.index);
+    aliveCount--;
+}
@@ -0,0 +1,178 @@
+﻿#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Легкий ECS для новых видов объектов (поезда, составные платформы,
+// частицы): сущность - только дескриптор, данные - в плотных массивах
+// компонентов, системы - циклы по этим массивам. Препятствия, монеты и
+// усиления сюда не переезжают: их кольца (Entities.h) опираются на порядок
+// спавна, а плотный массив при удалении переставляет строки.
+//
+// Дескриптор - номер ячейки и ее поколение. Уничтожение сущности
+// увеличивает поколение, поэтому старые дескрипторы после повторного
+// использования ячейки перестают находить что-либо - и в реестре, и в
+// массивах компонентов. Память выделяется только в Reserve (и при росте
+// сверх нее), так что в тике забега реестр годится под NoAllocationScope.
+
+struct EntityHandle {
+    uint32_t index;
+    uint32_t generation; // 0 - пустой дескриптор, живые начинаются с 1
+};
+
+inline bool operator==(EntityHandle a, EntityHandle b) {
+    return a.index == b.index && a.generation == b.generation;
+}
+inline bool operator!=(EntityHandle a, EntityHandle b) { return !(a == b); }
+
+const EntityHandle nullEntity = { 0, 0 };
+
+class EntityRegistry {
+public:
+    EntityRegistry() : aliveCount(0) {}
+
+    // Память под capacity ячеек: до стольких живых сущностей Create не
+    // выделяет память. Живые сущности не меняются
+    void Reserve(size_t capacity);
+    // Уничтожает все сущности (поколения растут - старые дескрипторы мертвы)
+    void Clear();
+
+    EntityHandle Create();
+    // Мертвый дескриптор игнорируется. Компоненты сущности снимает тот, кто
+    // владеет их массивами (ComponentArray::Remove) - реестр о них не знает
+    void Destroy(EntityHandle entity);
+    bool IsAlive(EntityHandle entity) const {
+        return entity.index < generations.size() && generations[entity.index] == entity.generation;
+    }
+
+    size_t GetAliveCount() const { return aliveCount; }
+    // Сколько ячеек когда-либо использовано (номера ячеек - меньше этого)
+    size_t GetIndexCount() const { return generations.size(); }
+
+private:
+    std::vector<uint32_t> generations; // Поколение живой сущности ячейки; у свободной - следующее
+    std::vector<uint32_t> freeIndices; // Стек освободившихся ячеек
+    size_t aliveCount;
+};
+
+// Компонент T у части сущностей (sparse set): значения лежат плотно и без
+// дыр, поэтому система идет по ним подряд; по номеру ячейки сущности
+// находится ее строка. Удаление переносит последнюю строку на место
+// удаленной - порядок строк не сохраняется
+template <typename T>
+class ComponentArray {
+public:
+    static const uint32_t npos = static_cast<uint32_t>(-1);
+
+    // entityCapacity - число ячеек реестра, componentCapacity - сколько
+    // сущностей могут иметь компонент одновременно
+    void Reserve(size_t entityCapacity, size_t componentCapacity) {
+        if (rows.size() < entityCapacity) rows.resize(entityCapacity, npos);
+        values.reserve(componentCapacity);
+        owners.reserve(componentCapacity);
+    }
+
+    void Clear() {
+        for (EntityHandle owner : owners) rows[owner.index] = npos;
+        values.clear();
+        owners.clear();
+    }
+
+    size_t GetCount() const { return values.size(); }
+
+    // Добавляет компонент или заменяет значение уже имеющегося
+    T& Add(EntityHandle entity, const T& value) {
+        if (entity.index >= rows.size()) rows.resize(entity.index + 1, npos);
+        uint32_t& row = rows[entity.index];
+        if (row != npos && owners[row] == entity) {
+            values[row] = value;
+            return values[row];
+        }
+        if (row != npos) {
+            // Строка осталась от уничтоженной сущности этой ячейки
+            RemoveRow(row);
+        }
+        row = static_cast<uint32_t>(values.size());
+        values.push_back(value);
+        owners.push_back(entity);
+        return values.back();
+    }
+
+    void Remove(EntityHandle entity) {
+        uint32_t row = FindRow(entity);
+        if (row != npos) RemoveRow(row);
+    }
+
+    bool Has(EntityHandle entity) const { return FindRow(entity) != npos; }
+    T* Find(EntityHandle entity) {
+        uint32_t row = FindRow(entity);
+        return row != npos ? &values[row] : nullptr;
+    }
+    const T* Find(EntityHandle entity) const {
+        uint32_t row = FindRow(entity);
+        return row != npos ? &values[row] : nullptr;
+    }
+
+    // Плотный доступ для систем: строки 0..GetCount()-1
+    T& operator[](size_t row) { return values[row]; }
+    const T& operator[](size_t row) const { return values[row]; }
+    EntityHandle GetOwner(size_t row) const { return owners[row]; }
+    T* GetData() { return values.data(); }
+    const T* GetData() const { return values.data(); }
+
+    // Система по одному компоненту: f(EntityHandle, T&)
+    template <typename F>
+    void ForEach(F f) {
+        // Указателями, а не индексом: так цикл по Vec3 векторизуется лучше
+        const EntityHandle* owner = owners.data();
+        for (T* value = values.data(), *end = value + values.size(); value != end; ++value, ++owner) {
+            f(*owner, *value);
+        }
+    }
+
+private:
+    std::vector<T> values;
+    std::vector<EntityHandle> owners; // Чья строка, параллельно values
+    std::vector<uint32_t> rows;       // Ячейка сущности -> строка или npos
+
+    uint32_t FindRow(EntityHandle entity) const {
+        if (entity.index >= rows.size()) return npos;
+        uint32_t row = rows[entity.index];
+        if (row == npos || owners[row] != entity) return npos;
+        return row;
+    }
+
+    void RemoveRow(uint32_t row) {
+        uint32_t last = static_cast<uint32_t>(values.size() - 1);
+        rows[owners[row].index] = npos;
+        if (row != last) {
+            values[row] = values[last];
+            owners[row] = owners[last];
+            rows[owners[row].index] = row;
+        }
+        values.pop_back();
+        owners.pop_back();
+    }
+};
+
+template <typename T>
+const uint32_t ComponentArray<T>::npos;
+
+// Система по двум компонентам: f(EntityHandle, A&, B&) для сущностей, у
+// которых есть оба. Идет по меньшему массиву и ищет строку в другом
+template <typename A, typename B, typename F>
+void ForEach(ComponentArray<A>& first, ComponentArray<B>& second, F f) {
+    if (first.GetCount() <= second.GetCount()) {
+        for (size_t row = 0; row < first.GetCount(); row++) {
+            EntityHandle entity = first.GetOwner(row);
+            if (B* other = second.Find(entity)) f(entity, first[row], *other);
+        }
+    }
+    else {
+        for (size_t row = 0; row < second.GetCount(); row++) {
+            EntityHandle entity = second.GetOwner(row);
+            if (A* other = first.Find(entity)) f(entity, *other, second[row]);
+        }
+    }
+}
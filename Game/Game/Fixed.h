@@ -0,0 +1,140 @@
+﻿#pragma once
+
+#include <cstdint>
+
+// Числа с фиксированной точкой для детерминированного режима симуляции
+// (GAME_FIXED_POINT). Вся арифметика целочисленная, поэтому результат не
+// зависит от компилятора, флагов оптимизации и FMA: повтор, записанный в
+// отладочной сборке MSVC, совпадает бит в бит с GCC -O3.
+// Переполнение насыщается до границ диапазона, а не заворачивается.
+
+// Q16.16: диапазон +-32768, шаг 1/65536
+struct Fixed {
+    static const int fractionBits = 16;
+    static const int32_t one = 1 << fractionBits;
+
+    int32_t raw;
+
+    constexpr Fixed() : raw(0) {}
+    constexpr Fixed(int value) : raw(Saturate(static_cast<int64_t>(value) * one)) {}
+    // Из float и double - с округлением к ближайшему; умножение на 2^16 точное
+    constexpr Fixed(float value) : raw(Saturate(Round(static_cast<double>(value) * one))) {}
+    constexpr Fixed(double value) : raw(Saturate(Round(value * one))) {}
+
+    static constexpr Fixed FromRaw(int32_t raw) { return Fixed(raw, 0); }
+
+    // Наружу (отрисовка, статистика) - только явно, чтобы случайно не
+    // считать половину формулы во float
+    explicit constexpr operator float() const { return static_cast<float>(raw) / one; }
+    explicit constexpr operator double() const { return static_cast<double>(raw) / one; }
+    explicit constexpr operator int() const { return raw / one; } // Отбрасывание дроби, как у float
+
+    static constexpr int32_t Saturate(int64_t value) {
+        return value > INT32_MAX ? INT32_MAX : (value < INT32_MIN ? INT32_MIN : static_cast<int32_t>(value));
+    }
+
+    Fixed& operator+=(Fixed other) { *this = *this + other; return *this; }
+    Fixed& operator-=(Fixed other) { *this = *this - other; return *this; }
+    Fixed& operator*=(Fixed other) { *this = *this * other; return *this; }
+    Fixed& operator/=(Fixed other) { *this = *this / other; return *this; }
+
+    friend constexpr Fixed operator+(Fixed a, Fixed b) { return FromRaw(Saturate(static_cast<int64_t>(a.raw) + b.raw)); }
+    friend constexpr Fixed operator-(Fixed a, Fixed b) { return FromRaw(Saturate(static_cast<int64_t>(a.raw) - b.raw)); }
+    friend constexpr Fixed operator-(Fixed a) { return FromRaw(Saturate(-static_cast<int64_t>(a.raw))); }
+
+    // Произведение в 64 битах, сдвиг вправо - округление вниз на любом компиляторе
+    friend constexpr Fixed operator*(Fixed a, Fixed b) {
+        return FromRaw(Saturate(FloorDivide(static_cast<int64_t>(a.raw) * b.raw, one)));
+    }
+
+    // Деление на ноль дает границу диапазона со знаком делимого
+    friend constexpr Fixed operator/(Fixed a, Fixed b) {
+        return b.raw == 0 ? FromRaw(a.raw < 0 ? INT32_MIN : INT32_MAX)
+            : FromRaw(Saturate(static_cast<int64_t>(a.raw) * one / b.raw));
+    }
+
+    friend constexpr bool operator==(Fixed a, Fixed b) { return a.raw == b.raw; }
+    friend constexpr bool operator!=(Fixed a, Fixed b) { return a.raw != b.raw; }
+    friend constexpr bool operator<(Fixed a, Fixed b) { return a.raw < b.raw; }
+    friend constexpr bool operator>(Fixed a, Fixed b) { return a.raw > b.raw; }
+    friend constexpr bool operator<=(Fixed a, Fixed b) { return a.raw <= b.raw; }
+    friend constexpr bool operator>=(Fixed a, Fixed b) { return a.raw >= b.raw; }
+
+private:
+    constexpr Fixed(int32_t raw, int) : raw(raw) {}
+
+    static constexpr int64_t Round(double value) {
+        return static_cast<int64_t>(value < 0.0 ? value - 0.5 : value + 0.5);
+    }
+
+    // Сдвиг отрицательных чисел вправо в C++14 зависит от реализации - делим явно
+    static constexpr int64_t FloorDivide(int64_t value, int64_t divisor) {
+        return value >= 0 ? value / divisor : -((-value + divisor - 1) / divisor);
+    }
+};
+
+// Целочисленный корень: побитовый подбор по raw << 16, без float
+inline Fixed Sqrt(Fixed value) {
+    if (value.raw <= 0) return Fixed();
+
+    uint64_t remainder = static_cast<uint64_t>(value.raw) << Fixed::fractionBits;
+    uint64_t result = 0;
+    uint64_t bit = uint64_t(1) << 62;
+    while (bit > remainder) bit >>= 2;
+
+    while (bit != 0) {
+        if (remainder >= result + bit) {
+            remainder -= result + bit;
+            result = (result >> 1) + bit;
+        }
+        else {
+            result >>= 1;
+        }
+        bit >>= 2;
+    }
+    return Fixed::FromRaw(static_cast<int32_t>(result));
+}
+
+inline Fixed Abs(Fixed value) {
+    return value.raw < 0 ? -value : value;
+}
+
+// Пройденный путь растет весь забег и не влезает в +-32768 - для него
+// 64-битное хранилище с тем же шагом 1/65536
+struct FixedDistance {
+    int64_t raw;
+
+    constexpr FixedDistance() : raw(0) {}
+    constexpr FixedDistance(Fixed value) : raw(value.raw) {}
+    constexpr FixedDistance(int value) : raw(static_cast<int64_t>(value) * Fixed::one) {}
+    constexpr FixedDistance(double value) : raw(static_cast<int64_t>(value < 0.0 ? value * Fixed::one - 0.5 : value * Fixed::one + 0.5)) {}
+
+    explicit constexpr operator Fixed() const { return Fixed::FromRaw(Fixed::Saturate(raw)); }
+    explicit constexpr operator double() const { return static_cast<double>(raw) / Fixed::one; }
+    explicit constexpr operator float() const { return static_cast<float>(static_cast<double>(raw) / Fixed::one); }
+
+    FixedDistance& operator+=(Fixed other) { raw += other.raw; return *this; }
+
+    friend constexpr FixedDistance operator+(FixedDistance a, Fixed b) { return FromRaw(a.raw + b.raw); }
+    friend constexpr FixedDistance operator-(FixedDistance a, Fixed b) { return FromRaw(a.raw - b.raw); }
+    friend constexpr FixedDistance operator-(FixedDistance a, FixedDistance b) { return FromRaw(a.raw - b.raw); }
+
+    // Отношение двух путей (доля отрезка) - уже в Q16.16
+    friend constexpr Fixed operator/(FixedDistance a, FixedDistance b) {
+        return b.raw == 0 ? Fixed::FromRaw(a.raw < 0 ? INT32_MIN : INT32_MAX)
+            : Fixed::FromRaw(Fixed::Saturate(a.raw * Fixed::one / b.raw));
+    }
+
+    friend constexpr bool operator==(FixedDistance a, FixedDistance b) { return a.raw == b.raw; }
+    friend constexpr bool operator<(FixedDistance a, FixedDistance b) { return a.raw < b.raw; }
+    friend constexpr bool operator>(FixedDistance a, FixedDistance b) { return a.raw > b.raw; }
+    friend constexpr bool operator<=(FixedDistance a, FixedDistance b) { return a.raw <= b.raw; }
+    friend constexpr bool operator>=(FixedDistance a, FixedDistance b) { return a.raw >= b.raw; }
+
+private:
+    static constexpr FixedDistance FromRaw(int64_t raw) {
+        FixedDistance result;
+        result.raw = raw;
+        return result;
+    }
+};
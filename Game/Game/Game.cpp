@@ -1,25 +1,17 @@
 ﻿#include "raylib.h"
 #include "rlgl.h"   
+#include "Simulation.h"
+#include "Replay.h"
+#include "Rewind.h"
 #include <vector>
 #include <string>
-#include <random>
 #include <algorithm>
+#include <random>
 
-// Типы препятствий
-enum class ObstacleType {
-    JUMP_OVER,    // Можно перепрыгнуть
-    DUCK_UNDER,   // Можно пригнуться
-    WALL,         // Нельзя пройти
-    LOW_BARRIER   // Низкий барьер - нельзя перепрыгнуть, можно пригнуться
-};
-
-// Типы усилений
-enum class PowerUpType {
-    SPEED_BOOST,      // Увеличение скорости
-    INVINCIBILITY,    // Неуязвимость
-    MAGNET,           // Магнит для монет
-    DOUBLE_POINTS     // Двойные очки
-};
+// Позиция из симуляции для raylib (в fixed-сборке - перевод из Q16.16)
+static Vector3 ToVector3(Vec3 value) {
+    return { ToFloat(value.x), ToFloat(value.y), ToFloat(value.z) };
+}
 
 // Структура для анимированной текстуры
 struct AnimatedTexture {
@@ -95,79 +87,14 @@ struct Upgrade {
     float increment;
 };
 
-// Структура для активных эффектов усилений
-struct ActivePowerUp {
-    PowerUpType type;
-    float timer;
-    float duration;
-};
-
-// Структура для игрока
-struct Player {
-    Vector3 position;
-    Vector3 size;
-    Color color;
-    float speed;
-    int lane; // 0 - левая, 1 - средняя, 2 - правая
-    int targetLane; // Целевая полоса для плавного перемещения
-    bool isJumping;
-    bool isRolling; // ЗАМЕНА: вместо isDucking теперь isRolling
-    float jumpVelocity;
-    float gravity;
-    int characterType;
-    bool isOnObstacle; // Находится ли на препятствии
-    float laneChangeSpeed; // Скорость перемещения между полосами
-    float rollCooldownTimer; // Таймер кулдауна для переката
-    float rollDuration; // Длительность текущего переката
-
-    // Эффекты усилений (теперь могут комбинироваться)
-    float originalSpeed;
-    std::vector<ActivePowerUp> activePowerUps;
-
-    // НОВОЕ: состояние падения
-    bool isFalling;
-    float fallTimer;
-    float fallRotation; // Вращение при падении
-};
-
-// Структура для препятствий
-struct Obstacle {
-    Vector3 position;
-    Vector3 size;
-    Color color;
-    int lane;
-    bool active;
-    float speed;
-    ObstacleType type;
-    Texture2D texture; // Текстура для препятствия
-    bool canLandOn; // Можно ли приземлиться сверху
-};
-
-// Структура для монет
-struct Coin {
-    Vector3 position;
-    bool active;
-    float speed;
-};
-
-// Структура для усилений
-struct PowerUp {
-    Vector3 position;
-    bool active;
-    float speed;
-    PowerUpType type;
-    float rotation; // Для анимации вращения
-    Texture2D texture; // Текстура для способности
-};
-
 // Структура для локации
 struct Location {
     std::string name;
     Color backgroundColor;
     Color groundColor;
-    Color leftLaneColor;   // Цвет левой полосы
-    Color middleLaneColor; // Цвет средней полосы
-    Color rightLaneColor;  // Цвет правой полосы
+    Color leftLaneColor;   // Цвет полос левой половины трассы
+    Color middleLaneColor; // Цвет средней полосы и разделительных между остальными
+    Color rightLaneColor;  // Цвет полос правой половины трассы
     Texture2D jumpTexture;
     Texture2D duckTexture;
     Texture2D wallTexture;
@@ -189,51 +116,99 @@ struct Character {
         : name(n), texture({ 0 }), fallTexture({ 0 }), defaultColor(color), useAnimatedTexture(false) {}
 };
 
-// НОВАЯ СТРУКТУРА: персонаж-компаньон (ОБНОВЛЕННАЯ)
-struct Companion {
-    Vector3 position;
-    Vector3 size;
-    Vector3 originalSize; // Сохраняем оригинальный размер
+// Внешний вид компаньона (логика компаньона - в Simulation)
+struct CompanionSkin {
     Color color;
-    float speed;
-    int lane;
-    int targetLane;
-    bool isActive;
-    float followDistance; // Дистанция следования за игроком (ПОЛОЖИТЕЛЬНАЯ - значит СЗАДИ)
     Texture2D texture; // Текстура компаньона
     bool useAnimatedTexture;
     AnimatedTexture animation;
 
-    // НОВОЕ: состояния как у игрока
-    bool isJumping;
-    bool isRolling;
-    float jumpVelocity;
-    float gravity;
-    bool isOnObstacle;
-
-    // НОВОЕ: таймеры для поведения
-    float followBehindTimer; // Таймер следования сзади (5 секунд)
-    float catchUpTimer;      // Таймер догоняния после столкновения
-    bool isCatchingUp;       // Флаг режима догоняния
-
-    // Конструктор
-    Companion() : position({ 0, 0, 0 }), size({ 0.8f, 1.6f, 0.8f }), originalSize({ 0.8f, 1.6f, 0.8f }), color(PURPLE), speed(5.0f),
-        lane(1), targetLane(1), isActive(false), followDistance(3.0f),
-        texture({ 0 }), useAnimatedTexture(false),
-        isJumping(false), isRolling(false), jumpVelocity(0), gravity(15.0f), isOnObstacle(false),
-        followBehindTimer(5.0f), catchUpTimer(0.0f), isCatchingUp(false) {}
+    CompanionSkin() : color(PURPLE), texture({ 0 }), useAnimatedTexture(false) {}
+};
+
+// Экраны игры. Каждый экран объявляет нужные ему ресурсы
+// (Game::GetScreenResources), при смене экрана лишнее выгружается
+enum class ScreenState {
+    MENU,
+    SHOP,
+    RUNNING,
+    FALLING,   // Игрок разбился, идет анимация падения
+    GAME_OVER
+};
+
+// Группы текстур, которые грузятся и выгружаются целиком
+enum ResourceSet : unsigned {
+    RESOURCES_NONE = 0,
+    RESOURCES_WORLD = 1 << 0,     // Препятствия и окружение одной локации
+    RESOURCES_CHARACTER = 1 << 1, // Текстуры, падение и анимация одного персонажа
+    RESOURCES_COMPANION = 1 << 2,
+    RESOURCES_POWER_UPS = 1 << 3,
+    RESOURCES_CROWD = 1 << 4      // Меш, шейдер и материал инстансной толпы
 };
 
+// Толпа рисуется одним вызовом DrawMeshInstanced: матрица каждого
+// последователя приходит атрибутом instanceTransform
+static const char* crowdVertexShader = R"(#version 330
+in vec3 vertexPosition;
+in vec2 vertexTexCoord;
+in mat4 instanceTransform;
+uniform mat4 mvp;
+out vec2 fragTexCoord;
+void main() {
+    fragTexCoord = vertexTexCoord;
+    gl_Position = mvp * instanceTransform * vec4(vertexPosition, 1.0);
+}
+)";
+
+static const char* crowdFragmentShader = R"(#version 330
+in vec2 fragTexCoord;
+uniform sampler2D texture0;
+uniform vec4 colDiffuse;
+out vec4 finalColor;
+void main() {
+    finalColor = texture(texture0, fragTexCoord) * colDiffuse;
+}
+)";
+
+// Размеры толпы, между которыми переключает клавиша C в меню
+const int crowdSizes[] = { 0, 100, 500, 1000 };
+const int crowdSizeCount = sizeof(crowdSizes) / sizeof(crowdSizes[0]);
+
+// Текстуры локации: файл "<локация>_<суффикс>", например city_jump.png
+struct LocationTextureSlot {
+    const char* suffix;
+    Texture2D Location::* texture;
+    bool isEnvironment;
+};
+
+const LocationTextureSlot locationTextureSlots[] = {
+    { "_jump.png", &Location::jumpTexture, false },
+    { "_duck.png", &Location::duckTexture, false },
+    { "_wall.png", &Location::wallTexture, false },
+    { "_barrier.png", &Location::lowBarrierTexture, false },
+    { "_left.png", &Location::leftEnvironmentTexture, true },
+    { "_right.png", &Location::rightEnvironmentTexture, true }
+};
+
+const int locationTextureCount = sizeof(locationTextureSlots) / sizeof(locationTextureSlots[0]);
+
+// Имена файлов строятся из имени в нижнем регистре: "Ninja" -> ninja_fall.png
+static std::string ToFilePrefix(const std::string& name) {
+    std::string prefix = name;
+    for (auto& c : prefix) {
+        if (c >= 'A' && c <= 'Z') c = static_cast<char>(c - 'A' + 'a');
+    }
+    return prefix;
+}
+
 // Структура для меню
 struct Menu {
-    bool isActive;
     int selectedLocation;
     int selectedCharacter;
     std::vector<Location> locations;
     std::vector<Character> characters;
 
     Menu() {
-        isActive = true;
         selectedLocation = 0;
         selectedCharacter = 0;
 
@@ -276,23 +251,21 @@ struct Menu {
 
 // Структура для магазина
 struct Shop {
-    bool isActive;
     int selectedUpgrade;
     std::vector<Upgrade> upgrades;
     int totalCoins;
 
     Shop() {
-        isActive = false;
         selectedUpgrade = 0;
         totalCoins = 0;
 
-        // Инициализация улучшений (теперь +2.5 секунды за уровень)
+        // Инициализация улучшений (значения по уровням берутся из ядра симуляции)
         upgrades = {
-            {"Speed Boost", "Increase speed boost duration", 1, 5, 20, 2.5f, 2.5f},
-            {"Invincibility", "Increase invincibility duration", 1, 5, 50, 2.5f, 2.5f},
-            {"Coin Magnet", "Increase magnet range and duration", 1, 5, 20, 2.5f, 2.5f},
-            {"Double Points", "Increase double points duration", 1, 5, 20, 2.5f, 2.5f},
-            {"Coin Value", "Increase coins value", 1, 5, 250, 100.0f, 25.0f}
+            {"Speed Boost", "Increase speed boost duration", 1, 5, 20, ToFloat(upgradeCurves[0].baseValue), ToFloat(upgradeCurves[0].increment)},
+            {"Invincibility", "Increase invincibility duration", 1, 5, 50, ToFloat(upgradeCurves[1].baseValue), ToFloat(upgradeCurves[1].increment)},
+            {"Coin Magnet", "Increase magnet range and duration", 1, 5, 20, ToFloat(upgradeCurves[2].baseValue), ToFloat(upgradeCurves[2].increment)},
+            {"Double Points", "Increase double points duration", 1, 5, 20, ToFloat(upgradeCurves[3].baseValue), ToFloat(upgradeCurves[3].increment)},
+            {"Coin Value", "Increase coins value", 1, 5, 250, ToFloat(upgradeCurves[4].baseValue), ToFloat(upgradeCurves[4].increment)}
         };
     }
 };
@@ -302,32 +275,63 @@ private:
     const int screenWidth = 1200;
     const int screenHeight = 900;
 
-    Player player;
-    Companion companion; // НОВОЕ: персонаж-компаньон
-    std::vector<Obstacle> obstacles;
-    std::vector<Coin> coins;
-    std::vector<PowerUp> powerUps;
-
-    float obstacleSpawnTimer;
-    float coinSpawnTimer;
-    float powerUpSpawnTimer;
-    const float obstacleSpawnInterval = 1.5f;
-    const float coinSpawnInterval = 2.0f;
-    const float powerUpSpawnInterval = 8.0f;
-
-    int score;
-    int coinsCollected;
-    bool gameOver;
-
-    float laneWidth;
-    float lanePositions[3];
+    // Вся игровая логика и состояние мира живут в ядре симуляции
+    Simulation sim;
+    int characterType; // Выбранный персонаж (влияет только на отрисовку)
+    CompanionSkin companionSkin;
 
     Camera3D camera;
-    float gameSpeed;
+
+    // Симуляция идет фиксированными тиками, отрисовка - с частотой кадров
+    const int targetFps = 60;
+    const float simTickRate = 120.0f;
+    const float simDt = 1.0f / simTickRate;
+    const int maxCatchUpSteps = 8; // Больше тиков за кадр не догоняем, остаток отбрасываем
+    float simAccumulator;
+    float renderAlpha; // Доля тика между предыдущим и текущим состоянием
+    InputState pendingInput;
+
+    const std::string difficultyPath = "difficulty.txt";
+
+    // Каждый забег записывается; запись можно посмотреть после game over
+    const std::string replayPath = "last_run.rpl";
+    ReplayRecorder recorder;
+    ReplayPlayer replayPlayer;
+    Replay loadedReplay;
+    bool isReplaying;
+
+    // Быстрое сохранение мира (F5 - сохранить, F9 - вернуться)
+    std::vector<uint8_t> quickSave;
+
+    // Перемотка после смерти (удерживать BACKSPACE, F2 - вкл/выкл):
+    // последние 10 секунд, ключевой кадр раз в полсекунды
+    const float rewindSeconds = 10.0f;
+    const float rewindSpeed = 2.0f; // Во сколько раз перемотка быстрее игры
+    bool rewindEnabled;
+    bool isRewinding;
+    float rewindAccumulator;
+    // Снимок растет вместе с историей игрока, которую читает толпа
+    RewindBuffer rewind = RewindBuffer(static_cast<size_t>(rewindSeconds * simTickRate), 60, 2 * 1024 * 1024, 32 * 1024);
 
     Menu menu;
     Shop shop;
-    float environmentOffset;
+    ScreenState screen;
+
+    // Что сейчас в видеопамяти (-1 - ничего)
+    int residentLocation;
+    int loadedLocationTextures; // Сколько слотов locationTextureSlots уже загружено
+    int residentCharacter;
+    bool companionLoaded;
+
+    int laneCount; // Ширина трассы, выбранная в меню (повтор ставит свою)
+
+    // Забег толпой: индекс в crowdSizes и ресурсы инстансной отрисовки
+    int crowdSizeIndex;
+    bool crowdLoaded;
+    Mesh crowdMesh;
+    Shader crowdShader;
+    Material crowdMaterial;
+    std::vector<Matrix> crowdTransforms; // Выделяется при загрузке, не каждый кадр
 
     // Текстуры для способностей (одинаковые на всех локациях)
     Texture2D speedBoostTexture;
@@ -335,11 +339,7 @@ private:
     Texture2D magnetTexture;
     Texture2D doublePointsTexture;
 
-    bool texturesLoaded;
-
-    // Константа для дальности спавна
-    const float spawnDistance = -30.0f;
-    const float despawnDistance = 15.0f;
+    bool texturesLoaded; // Текстуры способностей в памяти
 
     // Анимированные текстуры для персонажей
     std::vector<AnimatedTexture> characterAnimations;
@@ -348,132 +348,69 @@ public:
     Game() {
         InitWindow(screenWidth, screenHeight, "Runner 3D with Character Animations");
 
-        // Настройка дорожек
-        laneWidth = 4.0f;
-        lanePositions[0] = -laneWidth;
-        lanePositions[1] = 0.0f;
-        lanePositions[2] = laneWidth;
-
-        // Инициализация игрока
-        player.size = { 1.0f, 2.0f, 1.0f };
-        player.position = { lanePositions[1], 1.0f, 0.0f };
-        player.color = RED;
-        player.speed = 5.0f;
-        player.lane = 1;
-        player.targetLane = 1;
-        player.isJumping = false;
-        player.isRolling = false;
-        player.jumpVelocity = 0;
-        player.gravity = 15.0f;
-        player.characterType = 0;
-        player.isOnObstacle = false;
-        player.laneChangeSpeed = 15.0f;
-        player.rollCooldownTimer = 0.0f;
-        player.rollDuration = 0.0f;
-        player.isFalling = false; // НОВОЕ: инициализация состояния падения
-        player.fallTimer = 0.0f;
-        player.fallRotation = 0.0f;
-
-        // Инициализация эффектов усилений
-        player.originalSpeed = player.speed;
-        player.activePowerUps.clear();
-
-        // ИСПРАВЛЕНО: компаньон начинает СЗАДИ игрока (положительное Z)
-        companion.position = { lanePositions[1], 1.0f, player.position.z + companion.followDistance };
-        companion.isActive = true;
+        characterType = 0;
+        laneCount = minLaneCount;
+
+        // Кривую сложности дизайнеры правят в файле; без него - встроенная
+        DifficultyCurve difficulty;
+        if (LoadDifficultyCurve(difficultyPath, difficulty)) {
+            sim.SetDifficultyCurve(difficulty);
+        }
+
+        // Трасса первого забега
+        isReplaying = false;
+        rewindEnabled = true;
+        isRewinding = false;
+        rewindAccumulator = 0.0f;
+        ResetGame();
 
         // Инициализация 3D камеры
+        const Player& player = sim.GetPlayer();
         camera.position = { 0.0f, 5.0f, 10.0f };
-        camera.target = { player.position.x, player.position.y, player.position.z };
+        camera.target = ToVector3(player.position);
         camera.up = { 0.0f, 1.0f, 0.0f };
         camera.fovy = 45.0f;
         camera.projection = CAMERA_PERSPECTIVE;
 
-        // Таймеры
-        obstacleSpawnTimer = 0;
-        coinSpawnTimer = 0;
-        powerUpSpawnTimer = 0;
-
-        // Счет
-        score = 0;
-        coinsCollected = 0;
-        gameOver = false;
-
-        gameSpeed = 5.0f;
+        // Фиксированный шаг симуляции
+        simAccumulator = 0.0f;
+        renderAlpha = 0.0f;
+        pendingInput = { false, false, false, false };
 
-        // Настройки по умолчанию
+        // Текстуры не грузятся все сразу: каждый экран сам объявляет, что ему
+        // нужно, остальное выгружается. Меню подгружает выбранную локацию заранее
         texturesLoaded = false;
-        environmentOffset = 0.0f;
-
-        // Инициализация анимированных текстур
+        speedBoostTexture = { 0 };
+        invincibilityTexture = { 0 };
+        magnetTexture = { 0 };
+        doublePointsTexture = { 0 };
+        residentLocation = -1;
+        loadedLocationTextures = 0;
+        residentCharacter = -1;
+        companionLoaded = false;
+        crowdSizeIndex = 0;
+        crowdLoaded = false;
         characterAnimations.resize(menu.characters.size());
 
-        // Загружаем текстуры
-        LoadTextures();
-
-        // Загружаем анимированные текстуры для персонажей
-        LoadCharacterAnimations();
-
-        // НОВОЕ: загружаем текстуры падения для персонажей
-        LoadCharacterFallTextures();
+        screen = ScreenState::MENU;
+        UpdateResources(false);
 
-        // НОВОЕ: загружаем текстуру для компаньона
-        LoadCompanionTexture();
-
-        SetTargetFPS(60);
+        SetTargetFPS(targetFps);
     }
 
     ~Game() {
-        // Выгружаем текстуры локаций
-        UnloadLocationTextures();
-
-        // Выгружаем текстуры персонажей (включая текстуры падения)
-        UnloadCharacterTextures();
-
-        // Выгружаем анимированные текстуры
-        UnloadCharacterAnimations();
-
-        // Выгружаем текстуры способностей
-        UnloadTexture(speedBoostTexture);
-        UnloadTexture(invincibilityTexture);
-        UnloadTexture(magnetTexture);
-        UnloadTexture(doublePointsTexture);
-
-        // НОВОЕ: выгружаем текстуры падения персонажей
-        for (auto& character : menu.characters) {
-            if (IsTextureReady(character.fallTexture)) {
-                UnloadTexture(character.fallTexture);
-            }
-        }
-
-        // НОВОЕ: выгружаем текстуру компаньона
-        UnloadTexture(companion.texture);
-
+        UnloadResources(RESOURCES_NONE);
         CloseWindow();
     }
 
     void Run() {
         while (!WindowShouldClose()) {
-            Update();
+            Update(GetFrameTime());
             Draw();
         }
     }
 
 private:
-    // НОВАЯ ФУНКЦИЯ: загрузка текстур падения для всех персонажей
-    void LoadCharacterFallTextures() {
-        std::vector<std::string> fallTextureFiles = {
-            "default_fall.png",    // Для Default персонажа
-            "ninja_fall.png",      // Для Ninja персонажа  
-            "robot_fall.png",      // Для Robot персонажа
-            "girl_fall.png"        // Для Girl персонажа
-        };
-
-        for (int i = 0; i < (int)menu.characters.size(); i++) {
-            LoadCharacterFallTexture(fallTextureFiles[i], menu.characters[i].fallTexture, menu.characters[i].defaultColor);
-        }
-    }
-
     // НОВАЯ ФУНКЦИЯ: загрузка конкретной текстуры падения
     void LoadCharacterFallTexture(const std::string& filepath, Texture2D& fallTexture, Color characterColor) {
         if (FileExists(filepath.c_str())) {
@@ -538,7 +475,7 @@ private:
 
     // НОВАЯ ФУНКЦИЯ: получение текстуры падения для текущего персонажа
     Texture2D GetCurrentFallTexture() {
-        const Character& currentCharacter = menu.characters[player.characterType];
+        const Character& currentCharacter = menu.characters[characterType];
 
         if (IsTextureReady(currentCharacter.fallTexture)) {
             return currentCharacter.fallTexture;
@@ -554,9 +491,9 @@ private:
         if (FileExists("companion.png")) {
             Image image = LoadImage("companion.png");
             if (image.data != NULL) {
-                companion.texture = LoadTextureFromImage(image);
+                companionSkin.texture = LoadTextureFromImage(image);
                 UnloadImage(image);
-                companion.useAnimatedTexture = false;
+                companionSkin.useAnimatedTexture = false;
                 TraceLog(LOG_INFO, "Successfully loaded companion texture: companion.png");
                 return;
             }
@@ -570,64 +507,16 @@ private:
             "companion_frame4.png"
         };
 
-        if (LoadAnimatedTexture(companion.animation, gifFrames, 0.1f)) {
-            companion.useAnimatedTexture = true;
-            TraceLog(LOG_INFO, "Successfully loaded companion animation with %d frames", (int)companion.animation.frames.size());
+        if (LoadAnimatedTexture(companionSkin.animation, gifFrames, 0.1f)) {
+            companionSkin.useAnimatedTexture = true;
+            TraceLog(LOG_INFO, "Successfully loaded companion animation with %d frames", (int)companionSkin.animation.frames.size());
             return;
         }
 
         // Если ничего не найдено, используем простой цветной куб
         TraceLog(LOG_WARNING, "Companion texture not found, using colored cube");
-        companion.texture = { 0 }; // Пустая текстура
-        companion.useAnimatedTexture = false;
-    }
-
-    void LoadCharacterAnimations() {
-        // Создаем списки файлов для анимаций каждого персонажа
-        std::vector<std::vector<std::string>> characterFrameFiles = {
-            // Default character frames
-            {
-                "default_frame1.png",
-                "default_frame2.png",
-                "default_frame3.png",
-                "default_frame4.png"
-            },
-            // Ninja character frames
-            {
-                "ninja_frame1.png",
-                "ninja_frame2.png",
-                "ninja_frame3.png",
-                "ninja_frame4.png"
-            },
-            // Robot character frames
-            {
-                "robot_frame1.png",
-                "robot_frame2.png",
-                "robot_frame3.png",
-                "robot_frame4.png"
-            },
-            // Girl character frames  
-            {
-                "girl_frame1.png",
-                "girl_frame2.png",
-                "girl_frame3.png",
-                "girl_frame4.png"
-            }
-        };
-
-        for (int i = 0; i < (int)menu.characters.size(); i++) {
-            if (LoadAnimatedTexture(characterAnimations[i], characterFrameFiles[i], 0.1f)) {
-                menu.characters[i].useAnimatedTexture = true;
-                TraceLog(LOG_INFO, "Animated texture loaded for character: %s", menu.characters[i].name.c_str());
-            }
-            else {
-                menu.characters[i].useAnimatedTexture = false;
-                TraceLog(LOG_WARNING, "Failed to load animated texture for character: %s", menu.characters[i].name.c_str());
-
-                // Создаем простую анимацию из цветов как fallback
-                CreateFallbackAnimation(characterAnimations[i], menu.characters[i].defaultColor);
-            }
-        }
+        companionSkin.texture = { 0 }; // Пустая текстура
+        companionSkin.useAnimatedTexture = false;
     }
 
     void CreateFallbackAnimation(AnimatedTexture& animTex, Color baseColor) {
@@ -679,71 +568,252 @@ private:
         animTex.loaded = true;
     }
 
-    void UnloadCharacterAnimations() {
-        for (auto& animTex : characterAnimations) {
-            for (auto& frame : animTex.frames) {
-                if (IsTextureReady(frame)) {
-                    UnloadTexture(frame);
-                }
+    bool IsTextureReady(Texture2D texture) const {
+        return texture.id != 0 && texture.width > 0 && texture.height > 0;
+    }
+
+    void UnloadTextureIfReady(Texture2D& texture) {
+        if (IsTextureReady(texture)) UnloadTexture(texture);
+        texture = { 0 };
+    }
+
+    void UnloadAnimation(AnimatedTexture& animTex) {
+        for (auto& frame : animTex.frames) {
+            if (IsTextureReady(frame)) {
+                UnloadTexture(frame);
             }
-            animTex.frames.clear();
-            animTex.loaded = false;
         }
-        characterAnimations.clear();
+        animTex.frames.clear();
+        animTex.loaded = false;
     }
 
-    void UnloadLocationTextures() {
-        for (auto& location : menu.locations) {
-            if (IsTextureReady(location.jumpTexture)) UnloadTexture(location.jumpTexture);
-            if (IsTextureReady(location.duckTexture)) UnloadTexture(location.duckTexture);
-            if (IsTextureReady(location.wallTexture)) UnloadTexture(location.wallTexture);
-            if (IsTextureReady(location.lowBarrierTexture)) UnloadTexture(location.lowBarrierTexture);
-            if (IsTextureReady(location.leftEnvironmentTexture)) UnloadTexture(location.leftEnvironmentTexture);
-            if (IsTextureReady(location.rightEnvironmentTexture)) UnloadTexture(location.rightEnvironmentTexture);
+    // Что нужно экрану. Меню рисует только 2D, но заранее подгружает
+    // выбранные локацию и персонажа, чтобы забег начался без загрузки.
+    // Магазину 3D-ресурсы не нужны вовсе
+    unsigned GetScreenResources(ScreenState state) const {
+        switch (state) {
+        case ScreenState::MENU: return RESOURCES_WORLD | RESOURCES_CHARACTER;
+        case ScreenState::SHOP: return RESOURCES_NONE;
+        default:
+            return RESOURCES_WORLD | RESOURCES_CHARACTER | RESOURCES_COMPANION | RESOURCES_POWER_UPS |
+                (sim.GetCrowd().GetSize() > 0 ? RESOURCES_CROWD : RESOURCES_NONE);
         }
     }
 
-    void UnloadCharacterTextures() {
-        for (auto& character : menu.characters) {
-            if (IsTextureReady(character.texture)) UnloadTexture(character.texture);
-            if (IsTextureReady(character.fallTexture)) UnloadTexture(character.fallTexture); // НОВОЕ
+    // Группа целиком в памяти. Локация - только выбранная и со всеми слотами
+    bool IsResident(ResourceSet set) const {
+        switch (set) {
+        case RESOURCES_WORLD:
+            return residentLocation >= 0 && residentLocation == menu.selectedLocation &&
+                loadedLocationTextures == locationTextureCount;
+        case RESOURCES_CHARACTER: return residentCharacter >= 0;
+        case RESOURCES_COMPANION: return companionLoaded;
+        case RESOURCES_POWER_UPS: return texturesLoaded;
+        case RESOURCES_CROWD: return crowdLoaded;
+        default: return true;
         }
     }
 
-    bool IsTextureReady(Texture2D texture) const {
-        return texture.id != 0 && texture.width > 0 && texture.height > 0;
+    // В меню нужен выбираемый персонаж, в забеге - тот, кем играем
+    int GetWantedCharacter() const {
+        return screen == ScreenState::MENU ? menu.selectedCharacter : characterType;
     }
 
-    void LoadTextures() {
-        // ДОБАВЛЕНО: выгружаем старые текстуры если они уже загружены
-        if (texturesLoaded) {
-            UnloadLocationTextures();
-            UnloadCharacterTextures();
-            UnloadTexture(speedBoostTexture);
-            UnloadTexture(invincibilityTexture);
-            UnloadTexture(magnetTexture);
-            UnloadTexture(doublePointsTexture);
-            UnloadTexture(companion.texture); // НОВОЕ: выгружаем старую текстуру компаньона
+    // Выгружает лишнее и догружает недостающее для текущего экрана.
+    // Без immediate - не больше одного шага за вызов (меню догружает по кадру)
+    void UpdateResources(bool immediate) {
+        unsigned required = GetScreenResources(screen);
+        UnloadResources(required);
+        while (LoadNextResource(required) && immediate) {}
+    }
+
+    void UnloadResources(unsigned keep) {
+        if (residentLocation >= 0 && (!(keep & RESOURCES_WORLD) || residentLocation != menu.selectedLocation)) {
+            UnloadLocation(residentLocation);
+        }
+        if (residentCharacter >= 0 && (!(keep & RESOURCES_CHARACTER) || residentCharacter != GetWantedCharacter())) {
+            UnloadCharacter(residentCharacter);
+        }
+        // Материал толпы ссылается на текстуру компаньона - уходит вместе с ней
+        if (crowdLoaded && (!(keep & RESOURCES_CROWD) || !(keep & RESOURCES_COMPANION))) {
+            UnloadCrowd();
+        }
+        if (companionLoaded && !(keep & RESOURCES_COMPANION)) {
+            UnloadCompanionTexture();
+        }
+        if (texturesLoaded && !(keep & RESOURCES_POWER_UPS)) {
+            UnloadPowerUpTextures();
+        }
+    }
+
+    // Один шаг загрузки: одна текстура локации или одна группа целиком.
+    // false - все нужное уже в памяти
+    bool LoadNextResource(unsigned required) {
+        if (required & RESOURCES_WORLD) {
+            if (residentLocation < 0) {
+                residentLocation = menu.selectedLocation;
+                loadedLocationTextures = 0;
+            }
+            if (loadedLocationTextures < locationTextureCount) {
+                LoadLocationTexture(residentLocation, loadedLocationTextures++);
+                return true;
+            }
+        }
+        if ((required & RESOURCES_CHARACTER) && residentCharacter < 0) {
+            LoadCharacter(GetWantedCharacter());
+            return true;
+        }
+        if ((required & RESOURCES_COMPANION) && !companionLoaded) {
+            LoadCompanionTexture();
+            companionLoaded = true;
+            return true;
         }
+        if ((required & RESOURCES_POWER_UPS) && !texturesLoaded) {
+            LoadPowerUpTextures();
+            texturesLoaded = true;
+            return true;
+        }
+        if ((required & RESOURCES_CROWD) && !crowdLoaded) {
+            LoadCrowd();
+            return true;
+        }
+        return false;
+    }
+
+    void LoadLocationTexture(int index, int slot) {
+        Location& location = menu.locations[index];
+        const LocationTextureSlot& textureSlot = locationTextureSlots[slot];
+        std::string path = ToFilePrefix(location.name) + textureSlot.suffix;
+
+        if (textureSlot.isEnvironment) {
+            LoadEnvironmentTexture(path.c_str(), location.*textureSlot.texture);
+        }
+        else {
+            LoadObstacleTexture(path.c_str(), location.*textureSlot.texture);
+        }
+    }
+
+    void UnloadLocation(int index) {
+        Location& location = menu.locations[index];
+        for (const auto& slot : locationTextureSlots) {
+            UnloadTextureIfReady(location.*slot.texture);
+        }
+        residentLocation = -1;
+        loadedLocationTextures = 0;
+    }
+
+    // Текстура, текстура падения и анимация (или анимация-заглушка) персонажа
+    void LoadCharacter(int index) {
+        Character& character = menu.characters[index];
+        std::string prefix = ToFilePrefix(character.name);
 
-        // Загружаем текстуры способностей (одинаковые для всех локаций)
-        LoadPowerUpTextures();
+        LoadCharacterTexture((prefix + "_character.png").c_str(), character.texture);
+        LoadCharacterFallTexture(prefix + "_fall.png", character.fallTexture, character.defaultColor);
 
-        // ПОПЫТКА ЗАГРУЗИТЬ ТЕКСТУРЫ, НО НЕ БЛОКИРУЕМ ЗАПУСК
-        try {
-            LoadLocationTextures();
-            LoadCharacterTextures();
+        std::vector<std::string> frameFiles;
+        for (int i = 1; i <= 4; i++) {
+            frameFiles.push_back(prefix + "_frame" + std::to_string(i) + ".png");
         }
-        catch (...) {
-            TraceLog(LOG_WARNING, "Some textures failed to load, using defaults");
+
+        if (LoadAnimatedTexture(characterAnimations[index], frameFiles, 0.1f)) {
+            character.useAnimatedTexture = true;
+            TraceLog(LOG_INFO, "Animated texture loaded for character: %s", character.name.c_str());
+        }
+        else {
+            character.useAnimatedTexture = false;
+            TraceLog(LOG_WARNING, "Failed to load animated texture for character: %s", character.name.c_str());
+
+            // Создаем простую анимацию из цветов как fallback
+            CreateFallbackAnimation(characterAnimations[index], character.defaultColor);
         }
 
-        texturesLoaded = AreTexturesLoaded();
+        residentCharacter = index;
+    }
+
+    void UnloadCharacter(int index) {
+        Character& character = menu.characters[index];
+        UnloadTextureIfReady(character.texture);
+        UnloadTextureIfReady(character.fallTexture);
+        UnloadAnimation(characterAnimations[index]);
+        residentCharacter = -1;
+    }
 
-        TraceLog(LOG_INFO, "All textures loaded: %s", texturesLoaded ? "YES" : "NO");
+    void UnloadCompanionTexture() {
+        UnloadTextureIfReady(companionSkin.texture);
+        UnloadAnimation(companionSkin.animation);
+        companionLoaded = false;
+    }
+
+    void LoadCrowd() {
+        crowdMesh = GenMeshCube(1.0f, 1.0f, 1.0f); // Размер задает матрица экземпляра
+        crowdShader = LoadShaderFromMemory(crowdVertexShader, crowdFragmentShader);
+        crowdShader.locs[SHADER_LOC_MATRIX_MVP] = GetShaderLocation(crowdShader, "mvp");
+        crowdShader.locs[SHADER_LOC_MATRIX_MODEL] = GetShaderLocationAttrib(crowdShader, "instanceTransform");
+        crowdMaterial = LoadMaterialDefault();
+        crowdMaterial.shader = crowdShader;
+        crowdTransforms.resize(Crowd::maxSize);
+        crowdLoaded = true;
+    }
+
+    // UnloadMaterial выгрузил бы и текстуру компаньона - освобождаем только карты
+    void UnloadCrowd() {
+        UnloadMesh(crowdMesh);
+        UnloadShader(crowdShader);
+        MemFree(crowdMaterial.maps);
+        crowdMaterial.maps = nullptr;
+        crowdLoaded = false;
+    }
+
+    void UnloadPowerUpTextures() {
+        UnloadTextureIfReady(speedBoostTexture);
+        UnloadTextureIfReady(invincibilityTexture);
+        UnloadTextureIfReady(magnetTexture);
+        UnloadTextureIfReady(doublePointsTexture);
+        texturesLoaded = false;
+    }
 
-        // НОВОЕ: перезагружаем текстуру компаньона
-        LoadCompanionTexture();
+    // Экран забега (бег, падение, game over) определяет симуляция
+    ScreenState GetRunScreen() const {
+        if (!sim.IsGameOver()) return ScreenState::RUNNING;
+        return sim.GetPlayer().isFalling ? ScreenState::FALLING : ScreenState::GAME_OVER;
+    }
+
+    void ChangeScreen(ScreenState next) {
+        if (next == screen) return;
+
+        ExitScreen(screen);
+        screen = next;
+        EnterScreen(next);
+
+        // Забегу текстуры нужны сразу, меню догрузит их постепенно
+        UpdateResources(next != ScreenState::MENU);
+    }
+
+    void EnterScreen(ScreenState state) {
+        switch (state) {
+        case ScreenState::SHOP:
+            // Монеты забега уходят в магазин
+            shop.totalCoins += sim.GetCoinsCollected();
+            break;
+        case ScreenState::RUNNING:
+            // Время, накопленное на других экранах, забег не догоняет
+            simAccumulator = 0.0f;
+            pendingInput = { false, false, false, false };
+            break;
+        default:
+            break;
+        }
+    }
+
+    void ExitScreen(ScreenState state) {
+        switch (state) {
+        case ScreenState::SHOP:
+            // ИСПРАВЛЕНИЕ: сбрасываем coinsCollected только после того как они были добавлены в магазин
+            sim.ResetCoinsCollected();
+            break;
+        default:
+            break;
+        }
     }
 
     // Функция для загрузки текстур способностей
@@ -772,49 +842,6 @@ private:
         TraceLog(LOG_WARNING, "Power-up texture not found: %s, using default", filepath);
     }
 
-    void LoadLocationTextures() {
-        // Загружаем текстуры для каждой локации
-        // City
-        LoadObstacleTexture("city_jump.png", menu.locations[0].jumpTexture);
-        LoadObstacleTexture("city_duck.png", menu.locations[0].duckTexture);
-        LoadObstacleTexture("city_wall.png", menu.locations[0].wallTexture);
-        LoadObstacleTexture("city_barrier.png", menu.locations[0].lowBarrierTexture);
-        LoadEnvironmentTexture("city_left.png", menu.locations[0].leftEnvironmentTexture);
-        LoadEnvironmentTexture("city_right.png", menu.locations[0].rightEnvironmentTexture);
-
-        // Forest
-        LoadObstacleTexture("forest_jump.png", menu.locations[1].jumpTexture);
-        LoadObstacleTexture("forest_duck.png", menu.locations[1].duckTexture);
-        LoadObstacleTexture("forest_wall.png", menu.locations[1].wallTexture);
-        LoadObstacleTexture("forest_barrier.png", menu.locations[1].lowBarrierTexture);
-        LoadEnvironmentTexture("forest_left.png", menu.locations[1].leftEnvironmentTexture);
-        LoadEnvironmentTexture("forest_right.png", menu.locations[1].rightEnvironmentTexture);
-
-        // Desert
-        LoadObstacleTexture("desert_jump.png", menu.locations[2].jumpTexture);
-        LoadObstacleTexture("desert_duck.png", menu.locations[2].duckTexture);
-        LoadObstacleTexture("desert_wall.png", menu.locations[2].wallTexture);
-        LoadObstacleTexture("desert_barrier.png", menu.locations[2].lowBarrierTexture);
-        LoadEnvironmentTexture("desert_left.png", menu.locations[2].leftEnvironmentTexture);
-        LoadEnvironmentTexture("desert_right.png", menu.locations[2].rightEnvironmentTexture);
-
-        // Winter
-        LoadObstacleTexture("winter_jump.png", menu.locations[3].jumpTexture);
-        LoadObstacleTexture("winter_duck.png", menu.locations[3].duckTexture);
-        LoadObstacleTexture("winter_wall.png", menu.locations[3].wallTexture);
-        LoadObstacleTexture("winter_barrier.png", menu.locations[3].lowBarrierTexture);
-        LoadEnvironmentTexture("winter_left.png", menu.locations[3].leftEnvironmentTexture);
-        LoadEnvironmentTexture("winter_right.png", menu.locations[3].rightEnvironmentTexture);
-    }
-
-    void LoadCharacterTextures() {
-        // Загружаем текстуры для каждого персонажа (как fallback)
-        LoadCharacterTexture("default_character.png", menu.characters[0].texture);
-        LoadCharacterTexture("ninja_character.png", menu.characters[1].texture);
-        LoadCharacterTexture("robot_character.png", menu.characters[2].texture);
-        LoadCharacterTexture("girl_character.png", menu.characters[3].texture);
-    }
-
     void LoadEnvironmentTexture(const char* filepath, Texture2D& texture) {
         if (FileExists(filepath)) {
             Image image = LoadImage(filepath);
@@ -952,54 +979,34 @@ private:
         return texture;
     }
 
-    bool AreTexturesLoaded() const {
-        // ПРОСТАЯ ПРОВЕРКА ОСНОВНЫХ ТЕКСТУР
-        bool basicTexturesLoaded =
-            IsTextureReady(speedBoostTexture) &&
-            IsTextureReady(invincibilityTexture) &&
-            IsTextureReady(magnetTexture) &&
-            IsTextureReady(doublePointsTexture);
-
-        return basicTexturesLoaded;
-    }
-
+    // Текстура препятствия выбирается при отрисовке по текущей локации и типу.
+    // Если локация не в памяти целиком, DrawObstacle рисует цветной куб.
     Texture2D GetObstacleTexture(ObstacleType type) {
-        // Возвращаем текстуру препятствия в зависимости от текущей локации и типа
         const Location& currentLocation = menu.locations[menu.selectedLocation];
 
         switch (type) {
-        case ObstacleType::JUMP_OVER:
-            return IsTextureReady(currentLocation.jumpTexture) ? currentLocation.jumpTexture : CreateDefaultObstacleTexture();
-        case ObstacleType::DUCK_UNDER:
-            return IsTextureReady(currentLocation.duckTexture) ? currentLocation.duckTexture : CreateDefaultObstacleTexture();
-        case ObstacleType::WALL:
-            return IsTextureReady(currentLocation.wallTexture) ? currentLocation.wallTexture : CreateDefaultObstacleTexture();
-        case ObstacleType::LOW_BARRIER:
-            return IsTextureReady(currentLocation.lowBarrierTexture) ? currentLocation.lowBarrierTexture : CreateDefaultObstacleTexture();
-        default:
-            return CreateDefaultObstacleTexture();
+        case ObstacleType::JUMP_OVER: return currentLocation.jumpTexture;
+        case ObstacleType::DUCK_UNDER: return currentLocation.duckTexture;
+        case ObstacleType::WALL: return currentLocation.wallTexture;
+        case ObstacleType::LOW_BARRIER: return currentLocation.lowBarrierTexture;
+        default: return { 0 };
         }
     }
 
     // Функция для получения текстуры способности (одинаковая на всех локациях)
     Texture2D GetPowerUpTexture(PowerUpType type) {
         switch (type) {
-        case PowerUpType::SPEED_BOOST:
-            return IsTextureReady(speedBoostTexture) ? speedBoostTexture : CreateSpeedBoostTexture();
-        case PowerUpType::INVINCIBILITY:
-            return IsTextureReady(invincibilityTexture) ? invincibilityTexture : CreateInvincibilityTexture();
-        case PowerUpType::MAGNET:
-            return IsTextureReady(magnetTexture) ? magnetTexture : CreateMagnetTexture();
-        case PowerUpType::DOUBLE_POINTS:
-            return IsTextureReady(doublePointsTexture) ? doublePointsTexture : CreateDoublePointsTexture();
-        default:
-            return CreateSpeedBoostTexture();
+        case PowerUpType::SPEED_BOOST: return speedBoostTexture;
+        case PowerUpType::INVINCIBILITY: return invincibilityTexture;
+        case PowerUpType::MAGNET: return magnetTexture;
+        case PowerUpType::DOUBLE_POINTS: return doublePointsTexture;
+        default: return { 0 };
         }
     }
 
     Texture2D GetCharacterTexture() {
         // Возвращаем текстуру для выбранного персонажа
-        Texture2D charTexture = menu.characters[player.characterType].texture;
+        Texture2D charTexture = menu.characters[characterType].texture;
         return IsTextureReady(charTexture) ? charTexture : CreateDefaultCharacterTexture();
     }
 
@@ -1011,17 +1018,20 @@ private:
         return menu.locations[menu.selectedLocation].groundColor;
     }
 
-    // НОВЫЕ ФУНКЦИИ: получение цветов для каждой полосы
-    Color GetLeftLaneColor() {
-        return menu.locations[menu.selectedLocation].leftLaneColor;
+    // Цвет полосы при любой ширине трассы: крайние и каждая вторая от
+    // края - цвета своей половины, между ними и в центре - средний.
+    // На трех полосах это левая, средняя и правая
+    Color GetLaneColor(int lane) {
+        const Location& location = menu.locations[menu.selectedLocation];
+        int lastLane = sim.GetLaneCount() - 1;
+        int fromEdge = std::min(lane, lastLane - lane);
+        if (fromEdge % 2 != 0 || lane * 2 == lastLane) return location.middleLaneColor;
+        return lane * 2 < lastLane ? location.leftLaneColor : location.rightLaneColor;
     }
 
-    Color GetMiddleLaneColor() {
-        return menu.locations[menu.selectedLocation].middleLaneColor;
-    }
-
-    Color GetRightLaneColor() {
-        return menu.locations[menu.selectedLocation].rightLaneColor;
+    // Окружение стоит за краем трассы (на трех полосах - X = +-8)
+    float GetEnvironmentX() {
+        return ToFloat(sim.GetLanePosition(sim.GetLaneCount() - 1) + sim.GetLaneWidth() / 2) + 2.0f;
     }
 
     // Функции создания текстур для усилений (3D объекты)
@@ -1162,13 +1172,18 @@ private:
     void DrawObstacle(const Obstacle& obstacle) {
         if (obstacle.active) {
             // ИСПРАВЛЕНИЕ: улучшенная проверка текстур
-            if (texturesLoaded && IsTextureReady(obstacle.texture)) {
-                DrawCubeTexture(obstacle.position, obstacle.size, obstacle.texture, RAYWHITE);
+            Vector3 drawPosition = Interpolate(obstacle.previousPosition, obstacle.position);
+            const ObstacleArchetype& archetype = GetArchetype(obstacle.type);
+            Vector3 size = ToVector3(archetype.size);
+            Texture2D texture = GetObstacleTexture(obstacle.type);
+            if (IsResident(RESOURCES_WORLD) && IsTextureReady(texture)) {
+                DrawCubeTexture(drawPosition, size, texture, RAYWHITE);
             }
             else {
                 // Fallback - рисуем простой цветной куб если текстура не загружена
-                DrawCube(obstacle.position, obstacle.size.x, obstacle.size.y, obstacle.size.z, obstacle.color);
-                DrawCubeWires(obstacle.position, obstacle.size.x, obstacle.size.y, obstacle.size.z, BLACK);
+                Color color = { archetype.color[0], archetype.color[1], archetype.color[2], archetype.color[3] };
+                DrawCube(drawPosition, size.x, size.y, size.z, color);
+                DrawCubeWires(drawPosition, size.x, size.y, size.z, BLACK);
             }
         }
     }
@@ -1176,13 +1191,15 @@ private:
     // Функция для отрисовки способности с текстурой
     void DrawPowerUp(const PowerUp& powerUp) {
         if (powerUp.active) {
+            Vector3 drawPosition = Interpolate(powerUp.previousPosition, powerUp.position);
+            Texture2D texture = GetPowerUpTexture(powerUp.type);
             // ИСПРАВЛЕНИЕ: улучшенная проверка текстур
-            if (texturesLoaded && IsTextureReady(powerUp.texture)) {
+            if (IsResident(RESOURCES_POWER_UPS) && IsTextureReady(texture)) {
                 // Добавляем анимацию вращения и пульсации
                 float scale = 1.0f + 0.2f * sin(GetTime() * 5.0f);
                 Vector3 scaledSize = { scale, scale, scale };
 
-                DrawCubeTexture(powerUp.position, scaledSize, powerUp.texture, RAYWHITE);
+                DrawCubeTexture(drawPosition, scaledSize, texture, RAYWHITE);
             }
             else {
                 // Fallback - рисуем простую сферу если текстура не загружена
@@ -1194,17 +1211,18 @@ private:
                 case PowerUpType::DOUBLE_POINTS: powerUpColor = GREEN; break;
                 default: powerUpColor = WHITE;
                 }
-                DrawSphere(powerUp.position, 0.7f, powerUpColor);
+                DrawSphere(drawPosition, 0.7f, powerUpColor);
             }
         }
     }
 
     // ОБНОВЛЕННАЯ ФУНКЦИЯ: отрисовка компаньона
     void DrawCompanion() {
+        const Companion& companion = sim.GetCompanion();
         if (!companion.isActive) return;
 
-        Vector3 drawPosition = companion.position;
-        Vector3 drawSize = companion.size;
+        Vector3 drawPosition = Interpolate(companion.previousPosition, companion.position);
+        Vector3 drawSize = ToVector3(companion.size);
 
         // Если компаньон в перекате, корректируем позицию для визуального эффекта
         if (companion.isRolling) {
@@ -1212,23 +1230,23 @@ private:
         }
 
         // Если есть анимированная текстура и она загружена
-        if (companion.useAnimatedTexture && companion.animation.loaded) {
-            UpdateAnimatedTexture(companion.animation, GetFrameTime());
-            Texture2D currentFrame = GetCurrentFrame(companion.animation);
+        if (companionSkin.useAnimatedTexture && companionSkin.animation.loaded) {
+            UpdateAnimatedTexture(companionSkin.animation, GetFrameTime());
+            Texture2D currentFrame = GetCurrentFrame(companionSkin.animation);
             DrawCubeTexture(drawPosition, drawSize, currentFrame, RAYWHITE);
         }
         // Если есть статичная текстура и она загружена
-        else if (IsTextureReady(companion.texture)) {
-            DrawCubeTexture(drawPosition, drawSize, companion.texture, RAYWHITE);
+        else if (IsTextureReady(companionSkin.texture)) {
+            DrawCubeTexture(drawPosition, drawSize, companionSkin.texture, RAYWHITE);
         }
         else {
             // Fallback - рисуем простой цветной куб если текстура не загружена
-            Color companionColor = companion.color;
+            Color companionColor = companionSkin.color;
             if (companion.isCatchingUp) {
                 // Подсвечиваем при догонянии
-                companionColor = ColorBrightness(companion.color, 1.5f);
+                companionColor = ColorBrightness(companionSkin.color, 1.5f);
             }
-            if (companion.followBehindTimer <= 0) {
+            if (companion.isFallingBehind) {
                 // Подсвечиваем когда отстаем
                 companionColor = ColorBrightness(PURPLE, 0.7f);
             }
@@ -1237,9 +1255,57 @@ private:
         }
     }
 
+    // Вся толпа - один инстансный вызов с текстурой компаньона
+    void DrawCrowd() {
+        const Crowd& crowd = sim.GetCrowd();
+        int count = crowd.GetSize();
+        if (count == 0 || !crowdLoaded) return;
+
+        const Scalar* x = crowd.GetX();
+        const Scalar* y = crowd.GetY();
+        const Scalar* z = crowd.GetZ();
+        const Scalar* previousX = crowd.GetPreviousX();
+        const Scalar* previousY = crowd.GetPreviousY();
+        const Scalar* previousZ = crowd.GetPreviousZ();
+        const uint8_t* rolling = crowd.GetRolling();
+        Vector3 size = ToVector3(crowdFollowerSize);
+
+        for (int i = 0; i < count; i++) {
+            float drawX = ToFloat(previousX[i]) + (ToFloat(x[i]) - ToFloat(previousX[i])) * renderAlpha;
+            float drawY = ToFloat(previousY[i]) + (ToFloat(y[i]) - ToFloat(previousY[i])) * renderAlpha;
+            float drawZ = ToFloat(previousZ[i]) + (ToFloat(z[i]) - ToFloat(previousZ[i])) * renderAlpha;
+            float height = rolling[i] ? size.y / 2 : size.y;
+
+            // Масштаб, затем перенос (поля Matrix идут по строкам)
+            crowdTransforms[i] = {
+                size.x, 0.0f, 0.0f, drawX,
+                0.0f, height, 0.0f, drawY,
+                0.0f, 0.0f, size.z, drawZ,
+                0.0f, 0.0f, 0.0f, 1.0f
+            };
+        }
+
+        Texture2D texture = companionSkin.texture;
+        if (companionSkin.useAnimatedTexture && companionSkin.animation.loaded) {
+            texture = GetCurrentFrame(companionSkin.animation);
+        }
+        if (IsTextureReady(texture)) {
+            crowdMaterial.maps[MATERIAL_MAP_DIFFUSE].texture = texture;
+            crowdMaterial.maps[MATERIAL_MAP_DIFFUSE].color = WHITE;
+        }
+        else {
+            crowdMaterial.maps[MATERIAL_MAP_DIFFUSE].texture = { rlGetTextureIdDefault(), 1, 1, 1, PIXELFORMAT_UNCOMPRESSED_R8G8B8A8 };
+            crowdMaterial.maps[MATERIAL_MAP_DIFFUSE].color = companionSkin.color;
+        }
+
+        DrawMeshInstanced(crowdMesh, crowdMaterial, crowdTransforms.data(), count);
+    }
+
     // НОВОЕ: Функция для отрисовки окружения с учетом локации
     void DrawEnvironment() {
         const Location& currentLocation = menu.locations[menu.selectedLocation];
+        float offset = GetRenderEnvironmentOffset();
+        float sideX = GetEnvironmentX();
 
         switch (menu.selectedLocation) {
         case 0: // City - здания (близко к дороге)
@@ -1248,17 +1314,17 @@ private:
             for (int i = -5; i <= 5; i++) {
                 // Левая сторона с текстурой
                 if (IsTextureReady(currentLocation.leftEnvironmentTexture)) {
-                    DrawCubeTexture({ -8.0f, 4.0f, i * 10.0f + environmentOffset }, envSize, currentLocation.leftEnvironmentTexture, RAYWHITE);
+                    DrawCubeTexture({ -sideX, 4.0f, i * 10.0f + offset }, envSize, currentLocation.leftEnvironmentTexture, RAYWHITE);
                 }
                 else {
-                    DrawCube({ -8.0f, 4.0f, i * 10.0f + environmentOffset }, envSize.x, envSize.y, envSize.z, GRAY);
+                    DrawCube({ -sideX, 4.0f, i * 10.0f + offset }, envSize.x, envSize.y, envSize.z, GRAY);
                 }
                 // Правая сторона с текстурой
                 if (IsTextureReady(currentLocation.rightEnvironmentTexture)) {
-                    DrawCubeTexture({ 8.0f, 4.0f, i * 10.0f + environmentOffset }, envSize, currentLocation.rightEnvironmentTexture, RAYWHITE);
+                    DrawCubeTexture({ sideX, 4.0f, i * 10.0f + offset }, envSize, currentLocation.rightEnvironmentTexture, RAYWHITE);
                 }
                 else {
-                    DrawCube({ 8.0f, 4.0f, i * 10.0f + environmentOffset }, envSize.x, envSize.y, envSize.z, GRAY);
+                    DrawCube({ sideX, 4.0f, i * 10.0f + offset }, envSize.x, envSize.y, envSize.z, GRAY);
                 }
             }
         }
@@ -1270,17 +1336,17 @@ private:
             for (int i = -5; i <= 5; i++) {
                 // Левая сторона с текстурой - дальше от дороги
                 if (IsTextureReady(currentLocation.leftEnvironmentTexture)) {
-                    DrawCubeTexture({ -8.0f, 3.0f, i * 8.0f + environmentOffset }, envSize, currentLocation.leftEnvironmentTexture, RAYWHITE);
+                    DrawCubeTexture({ -sideX, 3.0f, i * 8.0f + offset }, envSize, currentLocation.leftEnvironmentTexture, RAYWHITE);
                 }
                 else {
-                    DrawCube({ -8.0f, 3.0f, i * 8.0f + environmentOffset }, envSize.x, envSize.y, envSize.z, GREEN);
+                    DrawCube({ -sideX, 3.0f, i * 8.0f + offset }, envSize.x, envSize.y, envSize.z, GREEN);
                 }
                 // Правая сторона с текстурой - дальше от дороги
                 if (IsTextureReady(currentLocation.rightEnvironmentTexture)) {
-                    DrawCubeTexture({ 8.0f, 3.0f, i * 8.0f + environmentOffset }, envSize, currentLocation.rightEnvironmentTexture, RAYWHITE);
+                    DrawCubeTexture({ sideX, 3.0f, i * 8.0f + offset }, envSize, currentLocation.rightEnvironmentTexture, RAYWHITE);
                 }
                 else {
-                    DrawCube({ 8.0f, 3.0f, i * 8.0f + environmentOffset }, envSize.x, envSize.y, envSize.z, GREEN);
+                    DrawCube({ sideX, 3.0f, i * 8.0f + offset }, envSize.x, envSize.y, envSize.z, GREEN);
                 }
             }
         }
@@ -1292,17 +1358,17 @@ private:
             for (int i = -5; i <= 5; i++) {
                 // Левая сторона с текстурой - еще дальше от дороги
                 if (IsTextureReady(currentLocation.leftEnvironmentTexture)) {
-                    DrawCubeTexture({ -8.0f, 2.0f, i * 12.0f + environmentOffset }, envSize, currentLocation.leftEnvironmentTexture, RAYWHITE);
+                    DrawCubeTexture({ -sideX, 2.0f, i * 12.0f + offset }, envSize, currentLocation.leftEnvironmentTexture, RAYWHITE);
                 }
                 else {
-                    DrawCube({ -8.0f, 2.0f, i * 12.0f + environmentOffset }, envSize.x, envSize.y, envSize.z, BROWN);
+                    DrawCube({ -sideX, 2.0f, i * 12.0f + offset }, envSize.x, envSize.y, envSize.z, BROWN);
                 }
                 // Правая сторона с текстурой - еще дальше от дороги
                 if (IsTextureReady(currentLocation.rightEnvironmentTexture)) {
-                    DrawCubeTexture({ 8.0f, 2.0f, i * 12.0f + environmentOffset }, envSize, currentLocation.rightEnvironmentTexture, RAYWHITE);
+                    DrawCubeTexture({ sideX, 2.0f, i * 12.0f + offset }, envSize, currentLocation.rightEnvironmentTexture, RAYWHITE);
                 }
                 else {
-                    DrawCube({ 8.0f, 2.0f, i * 12.0f + environmentOffset }, envSize.x, envSize.y, envSize.z, BROWN);
+                    DrawCube({ sideX, 2.0f, i * 12.0f + offset }, envSize.x, envSize.y, envSize.z, BROWN);
                 }
             }
         }
@@ -1314,17 +1380,17 @@ private:
             for (int i = -5; i <= 5; i++) {
                 // Левая сторона с текстурой - самые далекие от дороги
                 if (IsTextureReady(currentLocation.leftEnvironmentTexture)) {
-                    DrawCubeTexture({ -8.0f, 2.5f, i * 15.0f + environmentOffset }, envSize, currentLocation.leftEnvironmentTexture, RAYWHITE);
+                    DrawCubeTexture({ -sideX, 2.5f, i * 15.0f + offset }, envSize, currentLocation.leftEnvironmentTexture, RAYWHITE);
                 }
                 else {
-                    DrawCube({ -8.0f, 2.5f, i * 15.0f + environmentOffset }, envSize.x, envSize.y, envSize.z, WHITE);
+                    DrawCube({ -sideX, 2.5f, i * 15.0f + offset }, envSize.x, envSize.y, envSize.z, WHITE);
                 }
                 // Правая сторона с текстурой - самые далеки от дороги
                 if (IsTextureReady(currentLocation.rightEnvironmentTexture)) {
-                    DrawCubeTexture({ 8.0f, 2.5f, i * 15.0f + environmentOffset }, envSize, currentLocation.rightEnvironmentTexture, RAYWHITE);
+                    DrawCubeTexture({ sideX, 2.5f, i * 15.0f + offset }, envSize, currentLocation.rightEnvironmentTexture, RAYWHITE);
                 }
                 else {
-                    DrawCube({ 8.0f, 2.5f, i * 15.0f + environmentOffset }, envSize.x, envSize.y, envSize.z, WHITE);
+                    DrawCube({ sideX, 2.5f, i * 15.0f + offset }, envSize.x, envSize.y, envSize.z, WHITE);
                 }
             }
         }
@@ -1332,240 +1398,210 @@ private:
         }
     }
 
-    void Update() {
-        if (menu.isActive) {
+    void Update(float frameTime) {
+        switch (screen) {
+        case ScreenState::MENU:
             UpdateMenu();
-            return;
+            break;
+        case ScreenState::SHOP:
+            UpdateShop();
+            break;
+        default:
+            UpdateRun(frameTime);
+            if (screen != ScreenState::MENU && screen != ScreenState::SHOP) {
+                ChangeScreen(GetRunScreen());
+            }
+            break;
         }
 
-        if (shop.isActive) {
-            UpdateShop();
+        // Меню догружает выбранную локацию по текстуре за кадр
+        UpdateResources(false);
+    }
+
+    void UpdateRun(float frameTime) {
+        if (IsKeyPressed(KEY_F2)) {
+            rewindEnabled = !rewindEnabled;
+            rewind.Clear();
+        }
+
+        // Перемотка начинается после смерти и идет, пока клавиша зажата
+        if (rewindEnabled && !isReplaying && IsKeyDown(KEY_BACKSPACE) && (isRewinding || sim.IsGameOver())) {
+            UpdateRewind(frameTime);
             return;
         }
+        if (isRewinding) {
+            // Продолжаем с того места, где отпустили клавишу
+            isRewinding = false;
+            simAccumulator = 0.0f;
+            pendingInput = { false, false, false, false };
+        }
 
-        if (gameOver) {
-            // НОВОЕ: обрабатываем падение персонажа
-            if (player.isFalling) {
-                UpdatePlayerFall();
+        if (sim.IsGameOver() && !sim.GetPlayer().isFalling) {
+            // Монеты, собранные в повторе, в магазин не идут
+            if (isReplaying && (IsKeyPressed(KEY_R) || IsKeyPressed(KEY_M) || IsKeyPressed(KEY_S) || IsKeyPressed(KEY_P))) {
+                sim.ResetCoinsCollected();
+                isReplaying = false;
+            }
+            if (IsKeyPressed(KEY_P)) {
+                StartReplay();
                 return;
             }
-
             if (IsKeyPressed(KEY_R)) {
                 ResetGame();
             }
             if (IsKeyPressed(KEY_M)) {
-                menu.isActive = true;
+                ChangeScreen(ScreenState::MENU);
             }
-            if (IsKeyPressed(KEY_S)) {
+            else if (IsKeyPressed(KEY_S)) {
                 // Переход в магазин после игры
-                shop.totalCoins += coinsCollected;
-                shop.isActive = true;
+                ChangeScreen(ScreenState::SHOP);
             }
             return;
         }
 
-        // ОБНОВЛЯЕМ АНИМАЦИИ ПЕРСОНАЖЕЙ
-        float deltaTime = GetFrameTime();
-        for (auto& animTex : characterAnimations) {
-            UpdateAnimatedTexture(animTex, deltaTime);
+        // ОБНОВЛЯЕМ АНИМАЦИИ ПЕРСОНАЖЕЙ (визуальная часть - раз в кадр)
+        if (!sim.IsGameOver()) {
+            for (auto& animTex : characterAnimations) {
+                UpdateAnimatedTexture(animTex, frameTime);
+            }
         }
 
-        HandleInput();
-        UpdatePlayer();
-        UpdateCompanion(); // НОВОЕ: обновляем компаньона
-        UpdateObstacles();
-        UpdateCoins();
-        UpdatePowerUps();
-        UpdateCamera();
-        CheckCollisions();
-        UpdatePowerUpEffects();
-
-        environmentOffset += gameSpeed * 0.3f * GetFrameTime();
-        if (environmentOffset > 50.0f) environmentOffset = 0.0f;
-
-        score += HasPowerUp(PowerUpType::DOUBLE_POINTS) ? 2 : 1;
-    }
-
-    // НОВАЯ ФУНКЦИЯ: обновление компаньона (ПЕРЕРАБОТАНА)
-    void UpdateCompanion() {
-        if (!companion.isActive) return;
-
-        // Обновление состояний прыжка и переката (повторяем за игроком)
-        UpdateCompanionStates();
-
-        // Определение режима поведения
-        if (gameOver && player.isFalling) {
-            // При падении игрока компаньон продолжает бежать сзади, но не подбегает
-            companion.followDistance = 3.0f; // Обычная дистанция
-            companion.speed = player.originalSpeed; // Обычная скорость
-            companion.isCatchingUp = false;
+        if (!isReplaying && IsKeyPressed(KEY_F5)) {
+            quickSave.resize(sim.GetSnapshotSize());
+            quickSave.resize(sim.SaveSnapshot(quickSave.data(), quickSave.size()));
         }
-        else if (companion.followBehindTimer > 0) {
-            // Первые 5 секунд - бежим ВМЕСТЕ с игроком
-            companion.followBehindTimer -= GetFrameTime();
-            companion.followDistance = 3.0f; // Нормальная дистанция
-            companion.speed = player.originalSpeed; // Такая же скорость как у игрока
-        }
-        else {
-            // После 5 секунд - начинаем ОТСТАВАТЬ
-            companion.followDistance = 8.0f; // Большая дистанция сзади
-            companion.speed = player.originalSpeed * 0.8f; // Медленнее игрока
-            companion.isCatchingUp = false;
+        if (!isReplaying && IsKeyPressed(KEY_F9) && !quickSave.empty() && sim.LoadSnapshot(quickSave.data(), quickSave.size())) {
+            // Забег с откатом уже не воспроизвести по записи ввода
+            recorder.Cancel();
+            rewind.Clear();
+            simAccumulator = 0.0f;
+            pendingInput = { false, false, false, false };
         }
 
-        // Компаньон следует за игроком на выбранной дистанции
-        companion.targetLane = player.targetLane; // Следуем за целевой полосой игрока
+        // Нажатия копятся до ближайшего тика, чтобы не терять их на кадрах без тиков
+        PollInput();
 
-        // Плавное перемещение между полосами
-        float targetX = lanePositions[companion.targetLane];
-        if (fabs(companion.position.x - targetX) > 0.01f) {
-            float direction = (targetX > companion.position.x) ? 1.0f : -1.0f;
-            companion.position.x += direction * companion.speed * 0.8f * GetFrameTime();
+        simAccumulator += frameTime;
+        int steps = 0;
+        while (simAccumulator >= simDt && steps < maxCatchUpSteps) {
+            InputState input = isReplaying ? replayPlayer.NextInput(sim.GetTick()) : pendingInput;
+            recorder.Record(sim.GetTick(), input);
+            sim.Step(simDt, input);
+            pendingInput = { false, false, false, false };
 
-            if ((direction > 0 && companion.position.x > targetX) ||
-                (direction < 0 && companion.position.x < targetX)) {
-                companion.position.x = targetX;
-                companion.lane = companion.targetLane;
+            if (rewindEnabled && !isReplaying && !sim.IsGameOver()) {
+                rewind.Capture(sim);
             }
-        }
-        else {
-            companion.lane = companion.targetLane;
-        }
-
-        // Позиционирование по Z с учетом выбранной дистанции
-        companion.position.z = player.position.z + companion.followDistance;
-
-        // Обновление высоты (учет прыжков и препятствий)
-        UpdateCompanionHeight();
-    }
-
-    // НОВАЯ ФУНКЦИЯ: обновление состояний компаньона (ПОВТОРЯЕТ ДЕЙСТВИЯ ИГРОКА)
-    void UpdateCompanionStates() {
-        // ПОВТОРЯЕМ ДЕЙСТВИЯ ИГРОКА С НЕБОЛЬШОЙ ЗАДЕРЖКОЙ
-
-        // Прыжок - повторяем с небольшой задержкой
-        if (player.isJumping && !companion.isJumping) {
-            companion.isJumping = true;
-            companion.jumpVelocity = 8.0f;
-            companion.isOnObstacle = false;
-        }
 
-        // Перекат - повторяем с небольшой задержкой  
-        if (player.isRolling && !companion.isRolling) {
-            companion.isRolling = true;
-            companion.size.y = 1.0f; // Уменьшаем высоту для переката
-            companion.size.z = 1.2f; // Увеличиваем длину для переката
-            if (!companion.isJumping && !companion.isOnObstacle) {
-                companion.position.y = 0.5f;
+            if (sim.IsGameOver() && recorder.IsRecording()) {
+                SaveReplay(recorder.Finish(sim.GetTick(), sim.GetScore()), replayPath);
             }
+            simAccumulator -= simDt;
+            steps++;
         }
 
-        // Завершение переката
-        if (!player.isRolling && companion.isRolling) {
-            companion.isRolling = false;
-            companion.size = companion.originalSize; // Возвращаем оригинальный размер
-            if (!companion.isJumping && !companion.isOnObstacle) {
-                companion.position.y = 1.0f;
-            }
+        // После долгого зависания не пытаемся догнать все время - игра просто замедляется
+        if (steps == maxCatchUpSteps && simAccumulator >= simDt) {
+            simAccumulator = 0.0f;
         }
 
-        // Обновление прыжка (физика такая же как у игрока)
-        if (companion.isJumping) {
-            companion.position.y += companion.jumpVelocity * GetFrameTime();
-            companion.jumpVelocity -= companion.gravity * GetFrameTime();
-
-            if (companion.jumpVelocity < 0) { // Падаем вниз
-                float groundHeight = 1.0f;
-                float obstacleHeight = CheckCompanionObstacleLanding();
-
-                if (obstacleHeight > groundHeight) {
-                    if (companion.position.y <= obstacleHeight) {
-                        companion.position.y = obstacleHeight;
-                        companion.isJumping = false;
-                        companion.jumpVelocity = 0;
-                        companion.isOnObstacle = true;
-                    }
-                }
-                else {
-                    if (companion.position.y <= groundHeight) {
-                        companion.position.y = groundHeight;
-                        companion.isJumping = false;
-                        companion.jumpVelocity = 0;
-                        companion.isOnObstacle = false;
-                    }
-                }
-            }
-        }
+        renderAlpha = simAccumulator / simDt;
     }
 
-    // НОВАЯ ФУНКЦИЯ: проверка приземления компаньона на препятствия
-    float CheckCompanionObstacleLanding() {
-        float highestObstacle = 1.0f;
-
-        for (auto& obstacle : obstacles) {
-            if (obstacle.active && obstacle.lane == companion.lane && obstacle.canLandOn) {
-                BoundingBox companionBox = GetCompanionFrontFaceBox();
-                BoundingBox obstacleBox = GetObstacleFrontFaceBox(obstacle);
+    void UpdateRewind(float frameTime) {
+        if (!isRewinding) {
+            isRewinding = true;
+            rewindAccumulator = 0.0f;
+            // Забег с откатом уже не воспроизвести по записи ввода
+            recorder.Cancel();
+        }
 
-                if (CheckCollisionBoxes(companionBox, obstacleBox)) {
-                    float obstacleTop = obstacle.position.y + obstacle.size.y / 2;
-                    if (obstacleTop > highestObstacle) {
-                        highestObstacle = obstacleTop;
-                    }
-                }
-            }
+        rewindAccumulator += frameTime * simTickRate * rewindSpeed;
+        int steps = static_cast<int>(rewindAccumulator);
+        rewindAccumulator -= steps;
+        if (steps > 0) {
+            rewind.Rewind(sim, steps);
         }
+        renderAlpha = 1.0f;
+    }
 
-        return highestObstacle;
+    void PollInput() {
+        pendingInput.left = pendingInput.left || IsKeyPressed(KEY_LEFT);
+        pendingInput.right = pendingInput.right || IsKeyPressed(KEY_RIGHT);
+        pendingInput.jump = pendingInput.jump || IsKeyPressed(KEY_SPACE) || IsKeyPressed(KEY_UP);
+        pendingInput.roll = pendingInput.roll || IsKeyPressed(KEY_DOWN);
     }
 
-    // НОВАЯ ФУНКЦИЯ: получение bounding box для передней грани компаньона
-    BoundingBox GetCompanionFrontFaceBox() {
-        float frontOffset = companion.size.z / 2;
+    Vector3 Interpolate(Vec3 previousValue, Vec3 currentValue) const {
+        Vector3 previous = ToVector3(previousValue);
+        Vector3 current = ToVector3(currentValue);
         return {
-            { companion.position.x - companion.size.x / 2, companion.position.y - companion.size.y / 2, companion.position.z + frontOffset - 0.1f },
-            { companion.position.x + companion.size.x / 2, companion.position.y + companion.size.y / 2, companion.position.z + frontOffset + 0.1f }
+            previous.x + (current.x - previous.x) * renderAlpha,
+            previous.y + (current.y - previous.y) * renderAlpha,
+            previous.z + (current.z - previous.z) * renderAlpha
         };
     }
 
-    // НОВАЯ ФУНКЦИЯ: обновление высоты компаньона (УПРОЩЕННАЯ)
-    void UpdateCompanionHeight() {
-        // Просто поддерживаем правильную высоту в зависимости от состояния
-        if (!companion.isJumping && !companion.isRolling && !companion.isOnObstacle) {
-            companion.position.y = 1.0f;
-        }
+    float GetRenderEnvironmentOffset() const {
+        float environmentOffset = ToFloat(sim.GetEnvironmentOffset());
+        float previousEnvironmentOffset = ToFloat(sim.GetPreviousEnvironmentOffset());
+
+        // При переходе через 50 интерполяция дала бы рывок назад
+        if (environmentOffset < previousEnvironmentOffset) return environmentOffset;
+        return previousEnvironmentOffset + (environmentOffset - previousEnvironmentOffset) * renderAlpha;
     }
 
-    // НОВАЯ ФУНКЦИЯ: обновление анимации падения
-    void UpdatePlayerFall() {
-        player.fallTimer += GetFrameTime();
+    // Seed берется из системной энтропии; сама трасса от отрисовки и UI не зависит
+    static uint64_t NewRunSeed() {
+        std::random_device device;
+        return (static_cast<uint64_t>(device()) << 32) | device();
+    }
 
-        // Анимация падения: персонаж падает и вращается
-        if (player.fallTimer < 0.5f) {
-            // Фаза падения
-            player.position.y -= 8.0f * GetFrameTime();
-            player.fallRotation += 180.0f * GetFrameTime(); // Вращение при падении
-        }
-        else if (player.fallTimer < 5.0f) {
-            // Фаза лежания (5 секунд)
-            player.position.y = 0.1f; // Лежит на земле
-            player.fallRotation = 90.0f; // Лежит на боку
+    // Новый забег: сбрасываем мир и накопленное время
+    void ResetGame() {
+        ApplyShopUpgrades();
+        sim.SetLaneCount(laneCount);
+        sim.Reset(NewRunSeed());
+        recorder.Begin(sim, static_cast<uint16_t>(simTickRate));
+        rewind.Clear();
+        isReplaying = false;
+        simAccumulator = 0.0f;
+        renderAlpha = 0.0f;
+        pendingInput = { false, false, false, false };
+    }
+
+    // Повтор последнего забега из файла (туда же можно положить запись игрока)
+    void StartReplay() {
+        // Кривую сложности повтор не переносит: difficulty.txt мог поменяться после записи
+        if (!LoadReplay(replayPath, loadedReplay) || loadedReplay.tickRate != static_cast<uint16_t>(simTickRate) ||
+            loadedReplay.difficultyHash != sim.GetDifficultyCurve().GetHash()) {
+            return;
         }
-        else {
-            // После 5 секунд показываем меню
-            player.isFalling = false;
-            // Меню показывается автоматически в Draw()
+
+        // Монеты прошлого забега сразу уходят в магазин, чтобы не смешаться с монетами повтора
+        shop.totalCoins += sim.GetCoinsCollected();
+        sim.ResetCoinsCollected();
+
+        replayPlayer.Start(loadedReplay, sim);
+        recorder.Cancel();
+        rewind.Clear();
+        isReplaying = true;
+        simAccumulator = 0.0f;
+        renderAlpha = 0.0f;
+        pendingInput = { false, false, false, false };
+    }
+
+    // Уровни улучшений из магазина (повтор мог подменить их своими)
+    void ApplyShopUpgrades() {
+        for (size_t i = 0; i < shop.upgrades.size(); i++) {
+            sim.SetUpgradeLevel(static_cast<UpgradeType>(i), shop.upgrades[i].level);
         }
     }
 
     void UpdateMenu() {
-        int oldLocation = menu.selectedLocation;
-
-        // Обработка входа в магазин из меню
+        // Обработка входа в магазин из меню (монеты добавляет EnterScreen)
         if (IsKeyPressed(KEY_S)) {
-            shop.totalCoins += coinsCollected; // ИСПРАВЛЕНИЕ: добавляем монеты в магазин
-            shop.isActive = true;
-            menu.isActive = false;
+            ChangeScreen(ScreenState::SHOP);
             return;
         }
 
@@ -1579,17 +1615,23 @@ private:
         if (IsKeyPressed(KEY_A)) {
             if (menu.selectedCharacter > 0) menu.selectedCharacter--;
         }
+        if (IsKeyPressed(KEY_L)) {
+            // Трасса перестраивается сразу - меню показывает новую ширину
+            laneCount = laneCount < maxLaneCount ? laneCount + 1 : minLaneCount;
+            ResetGame();
+        }
+        if (IsKeyPressed(KEY_C)) {
+            crowdSizeIndex = (crowdSizeIndex + 1) % crowdSizeCount;
+            sim.SetCrowdSize(crowdSizes[crowdSizeIndex]);
+        }
         if (IsKeyPressed(KEY_D)) {
             if (menu.selectedCharacter < (int)menu.characters.size() - 1) menu.selectedCharacter++;
         }
 
+        // Текстуры новой выбранной локации начнут подгружаться со следующего кадра
         if (IsKeyPressed(KEY_ENTER)) {
-            player.characterType = menu.selectedCharacter;
-            menu.isActive = false;
-        }
-
-        if (oldLocation != menu.selectedLocation) {
-            // При смене локации автоматически применяем настройки
+            characterType = menu.selectedCharacter;
+            ChangeScreen(GetRunScreen());
         }
     }
 
@@ -1609,10 +1651,7 @@ private:
 
         // Выход из магазина - возврат в меню
         if (IsKeyPressed(KEY_ESCAPE) || IsKeyPressed(KEY_M) || IsKeyPressed(KEY_S)) {
-            // ИСПРАВЛЕНИЕ: сбрасываем coinsCollected только после того как они были добавлены в магазин
-            coinsCollected = 0;
-            shop.isActive = false;
-            menu.isActive = true;
+            ChangeScreen(ScreenState::MENU);
         }
     }
 
@@ -1623,660 +1662,57 @@ private:
             shop.totalCoins -= upgrade.cost;
             upgrade.level++;
             upgrade.value += upgrade.increment;
+            sim.SetUpgradeLevel(static_cast<UpgradeType>(index), upgrade.level);
 
             // Увеличиваем стоимость для следующего уровня
             upgrade.cost = static_cast<int>(upgrade.cost * 1.5f);
         }
     }
 
-    void HandleInput() {
-        // Движение влево-вправо с плавным перемещением
-        if (IsKeyPressed(KEY_LEFT) && player.targetLane > 0) {
-            player.targetLane--;
-        }
-        if (IsKeyPressed(KEY_RIGHT) && player.targetLane < 2) {
-            player.targetLane++;
-        }
-
-        // Прыжок
-        if ((IsKeyPressed(KEY_SPACE) || IsKeyPressed(KEY_UP)) && !player.isJumping && !player.isRolling) {
-            player.isJumping = true;
-            player.jumpVelocity = 8.0f;
-            player.isOnObstacle = false; // Сбрасываем статус нахождения на препятствии при прыжке
-        }
-
-        // ПЕРЕКАТ вместо приседания - теперь это мгновенное действие с кулдауном
-        if (IsKeyPressed(KEY_DOWN) && !player.isJumping && !player.isRolling && player.rollCooldownTimer <= 0) {
-            player.isRolling = true;
-            player.rollDuration = 0.0f; // Сбрасываем длительность переката
-            player.size.y = 1.0f; // Уменьшаем высоту для переката
-            player.position.y = 0.5f;
-            player.rollCooldownTimer = 1.5f; // КУЛДАУН 1.5 СЕКУНДЫ (было 1.0f)
-        }
-    }
-
-    void UpdatePlayer() {
-        // Обновляем таймер кулдауна переката
-        if (player.rollCooldownTimer > 0) {
-            player.rollCooldownTimer -= GetFrameTime();
-        }
-
-        // Обновление переката
-        if (player.isRolling) {
-            player.rollDuration += GetFrameTime();
-
-            if (player.rollDuration >= 1.0f) { // ПЕРЕКАТ ДЛИТСЯ 1 СЕКУНДУ (было 0.5f)
-                player.isRolling = false;
-                player.size.y = 2.0f; // Возвращаем нормальную высоту
-                if (!player.isJumping && !player.isOnObstacle) {
-                    player.position.y = 1.0f;
-                }
-            }
-        }
-
-        // Плавное перемещение между полосами с УВЕЛИЧЕННОЙ СКОРОСТЬЮ
-        float targetX = lanePositions[player.targetLane];
-        if (fabs(player.position.x - targetX) > 0.01f) {
-            float direction = (targetX > player.position.x) ? 1.0f : -1.0f;
-            player.position.x += direction * player.laneChangeSpeed * GetFrameTime();
-
-            // Ограничиваем позицию, чтобы не перескакивать целевую позицию
-            if ((direction > 0 && player.position.x > targetX) ||
-                (direction < 0 && player.position.x < targetX)) {
-                player.position.x = targetX;
-                player.lane = player.targetLane; // Обновляем текущую полосу когда достигаем цели
-            }
-        }
-        else {
-            player.lane = player.targetLane; // Обновляем текущую полосу
-        }
-
-        // Обновление прыжка
-        if (player.isJumping) {
-            player.position.y += player.jumpVelocity * GetFrameTime();
-            player.jumpVelocity -= player.gravity * GetFrameTime();
-
-            // Проверяем приземление на препятствие или землю
-            if (player.jumpVelocity < 0) { // Падаем вниз
-                float groundHeight = 1.0f;
-                float obstacleHeight = CheckObstacleLanding();
-
-                if (obstacleHeight > groundHeight) {
-                    // Приземляемся на препятствие
-                    if (player.position.y <= obstacleHeight) {
-                        player.position.y = obstacleHeight;
-                        player.isJumping = false;
-                        player.jumpVelocity = 0;
-                        player.isOnObstacle = true;
-                    }
-                }
-                else {
-                    // Приземляемся на землю
-                    if (player.position.y <= groundHeight) {
-                        player.position.y = groundHeight;
-                        player.isJumping = false;
-                        player.jumpVelocity = 0;
-                        player.isOnObstacle = false;
-                    }
-                }
-            }
-        }
-    }
-
-    float CheckObstacleLanding() {
-        float highestObstacle = 1.0f; // Высота земли по умолчанию
-
-        for (auto& obstacle : obstacles) {
-            if (obstacle.active && obstacle.lane == player.lane && obstacle.canLandOn) {
-                // Проверяем только переднюю грань для приземления
-                BoundingBox playerBox = GetPlayerFrontFaceBox();
-                BoundingBox obstacleBox = GetObstacleFrontFaceBox(obstacle);
-
-                if (CheckCollisionBoxes(playerBox, obstacleBox)) {
-                    float obstacleTop = obstacle.position.y + obstacle.size.y / 2;
-                    if (obstacleTop > highestObstacle) {
-                        highestObstacle = obstacleTop;
-                    }
-                }
-            }
-        }
-
-        return highestObstacle;
-    }
-
-    BoundingBox GetPlayerFrontFaceBox() {
-        // Создаем bounding box только для передней грани игрока
-        float frontOffset = player.size.z / 2;
-        return {
-            { player.position.x - player.size.x / 2, player.position.y - player.size.y / 2, player.position.z + frontOffset - 0.1f },
-            { player.position.x + player.size.x / 2, player.position.y + player.size.y / 2, player.position.z + frontOffset + 0.1f }
-        };
-    }
-
-    BoundingBox GetObstacleFrontFaceBox(const Obstacle& obstacle) {
-        // Создаем bounding box только для передней грани препятствия
-        float frontOffset = obstacle.size.z / 2;
-        return {
-            { obstacle.position.x - obstacle.size.x / 2, obstacle.position.y - obstacle.size.y / 2, obstacle.position.z + frontOffset - 0.1f },
-            { obstacle.position.x + obstacle.size.x / 2, obstacle.position.y + obstacle.size.y / 2, obstacle.position.z + frontOffset + 0.1f }
-        };
-    }
-
-    void UpdateObstacles() {
-        // Спавн препятствий
-        obstacleSpawnTimer += GetFrameTime();
-        if (obstacleSpawnTimer >= obstacleSpawnInterval) {
-            if (GetRandomValue(0, 100) < 40) {
-                SpawnObstacleGroup();
-            }
-            else {
-                SpawnSingleObstacle();
-            }
-            obstacleSpawnTimer = 0;
-        }
-
-        // Обновление позиций препятствий
-        for (auto& obstacle : obstacles) {
-            if (obstacle.active) {
-                obstacle.position.z += obstacle.speed * GetFrameTime();
-
-                // ИСПРАВЛЕНИЕ: используем новую дальность деактивации
-                if (obstacle.position.z > despawnDistance) {
-                    obstacle.active = false;
-                }
-            }
-        }
-
-        obstacles.erase(std::remove_if(obstacles.begin(), obstacles.end(),
-            [](const Obstacle& o) { return !o.active; }), obstacles.end());
-    }
-
-    void SpawnSingleObstacle() {
-        Obstacle obstacle;
-        obstacle.lane = GetRandomValue(0, 2);
-
-        int obstacleType = GetRandomValue(0, 3);
-        switch (obstacleType) {
-        case 0:
-            obstacle.type = ObstacleType::JUMP_OVER;
-            obstacle.size = { 1.0f, 1.0f, 1.0f }; // Можно перепрыгнуть
-            obstacle.color = DARKGRAY;
-            obstacle.canLandOn = true; // Можно приземлиться сверху
-            break;
-        case 1:
-            obstacle.type = ObstacleType::DUCK_UNDER;
-            obstacle.size = { 1.0f, 1.0f, 1.0f }; // ИЗМЕНЕНО: такая же высота как JUMP_OVER (было 1.5f)
-            obstacle.color = BROWN;
-            obstacle.canLandOn = false; // Нельзя приземлиться сверху
-            break;
-        case 2:
-            obstacle.type = ObstacleType::WALL;
-            obstacle.size = { 1.0f, 3.0f, 1.0f };
-            obstacle.color = MAROON;
-            obstacle.canLandOn = false; // Нельзя приземлиться сверху
-            break;
-        case 3:
-            obstacle.type = ObstacleType::LOW_BARRIER;
-            obstacle.size = { 1.0f, 2.5f, 1.0f }; // Выше - нельзя перепрыгнуть, можно пригнуться
-            obstacle.color = { 150, 75, 0, 255 };
-            obstacle.canLandOn = false; // Нельзя приземлиться сверху
-            break;
-        }
-
-        // Назначаем текстуру в зависимости от локации и типа препятствия
-        obstacle.texture = GetObstacleTexture(obstacle.type);
-
-        // ИСПРАВЛЕНИЕ: используем новую дальность спавна
-        obstacle.position = { lanePositions[obstacle.lane], obstacle.size.y / 2, spawnDistance };
-        obstacle.active = true;
-        obstacle.speed = gameSpeed + (static_cast<float>(score) / 1000.0f);
-
-        obstacles.push_back(obstacle);
-    }
-
-    void SpawnObstacleGroup() {
-        bool hasPassableLane = false;
-        std::vector<ObstacleType> laneTypes(3);
-
-        do {
-            for (int lane = 0; lane < 3; lane++) {
-                int obstacleType = GetRandomValue(0, 3);
-                switch (obstacleType) {
-                case 0:
-                    laneTypes[lane] = ObstacleType::JUMP_OVER;
-                    break;
-                case 1:
-                    laneTypes[lane] = ObstacleType::DUCK_UNDER;
-                    break;
-                case 2:
-                    laneTypes[lane] = ObstacleType::WALL;
-                    break;
-                case 3:
-                    laneTypes[lane] = ObstacleType::LOW_BARRIER;
-                    break;
-                }
-            }
-
-            for (int lane = 0; lane < 3; lane++) {
-                if (laneTypes[lane] != ObstacleType::WALL) {
-                    hasPassableLane = true;
-                    break;
-                }
-            }
-        } while (!hasPassableLane);
-
-        for (int lane = 0; lane < 3; lane++) {
-            Obstacle obstacle;
-            obstacle.lane = lane;
-            obstacle.type = laneTypes[lane];
-
-            switch (obstacle.type) {
-            case ObstacleType::JUMP_OVER:
-                obstacle.size = { 1.0f, 1.0f, 1.0f }; // Можно перепрыгнуть
-                obstacle.color = DARKGRAY;
-                obstacle.canLandOn = true; // Можно приземлиться сверху
-                break;
-            case ObstacleType::DUCK_UNDER:
-                obstacle.size = { 1.0f, 1.0f, 1.0f }; // ИЗМЕНЕНО: такая же высота как JUMP_OVER (было 1.5f)
-                obstacle.color = BROWN;
-                obstacle.canLandOn = false; // Нельзя приземлиться сверху
-                break;
-            case ObstacleType::WALL:
-                obstacle.size = { 1.0f, 3.0f, 1.0f };
-                obstacle.color = MAROON;
-                obstacle.canLandOn = false; // Нельзя приземлиться сверху
-                break;
-            case ObstacleType::LOW_BARRIER:
-                obstacle.size = { 1.0f, 2.5f, 1.0f }; // Выше - нельзя перепрыгнуть, можно пригнуться
-                obstacle.color = { 150, 75, 0, 255 };
-                obstacle.canLandOn = false; // Нельзя приземлиться сверху
-                break;
-            }
-
-            // Назначаем текстуру в зависимости от локации и типа препятствия
-            obstacle.texture = GetObstacleTexture(obstacle.type);
-
-            // ИСПРАВЛЕНИЕ: используем новую дальность спавна
-            obstacle.position = { lanePositions[obstacle.lane], obstacle.size.y / 2, spawnDistance };
-            obstacle.active = true;
-            obstacle.speed = gameSpeed + (static_cast<float>(score) / 1000.0f);
-
-            obstacles.push_back(obstacle);
-        }
-    }
-
-    void UpdateCoins() {
-        // Спавн монет
-        coinSpawnTimer += GetFrameTime();
-        if (coinSpawnTimer >= coinSpawnInterval) {
-            SpawnCoin();
-            coinSpawnTimer = 0;
-        }
-
-        // Обновление позиций монет
-        for (auto& coin : coins) {
-            if (coin.active) {
-                // Монеты движутся с той же скоростью, что и препятствия
-                coin.speed = gameSpeed + (static_cast<float>(score) / 1000.0f);
-
-                // Эффект магнита: монеты притягиваются к игроку
-                if (HasPowerUp(PowerUpType::MAGNET)) {
-                    float magnetRange = 5.0f + (shop.upgrades[2].level * 0.5f);
-                    float dx = player.position.x - coin.position.x;
-                    float dz = player.position.z - coin.position.z;
-                    float distance = sqrt(dx * dx + dz * dz);
-
-                    if (distance < magnetRange && distance > 0.5f) {
-                        // СИЛА ПРИТЯЖЕНИЯ ЗАВИСИТ ОТ СКОРОСТИ И РАССТОЯНИЯ
-                        float pullStrength = 20.0f + (coin.speed * 0.8f);
-
-                        // ПЛАВНОЕ ПРИТЯЖЕНИЕ
-                        float attraction = pullStrength * GetFrameTime() * (1.0f - distance / magnetRange);
-                        coin.position.x += (dx / distance) * attraction;
-
-                        // ОСНОВНОЕ ДВИЖЕНИЕ ВПЕРЕД + ДОПОЛНИТЕЛЬНОЕ УСКОРЕНИЕ К ИГРОКУ
-                        coin.position.z += coin.speed * GetFrameTime();
-                        coin.position.z += (dz / distance) * attraction * 2.0f; // Более сильное притяжение по Z
-
-                        // ДОПОЛНИТЕЛЬНОЕ УСКОРЕНИЕ ПРИ БЛИЗКОМ РАССТОЯНИИ
-                        if (distance < 2.0f) {
-                            coin.position.z += coin.speed * 0.5f * GetFrameTime();
-                        }
-                    }
-                    else {
-                        // ОБЫЧНОЕ ДВИЖЕНИЕ ЕСЛИ МОНЕТА ВНЕ ДИАПАЗОНА МАГНИТА
-                        coin.position.z += coin.speed * GetFrameTime();
-                    }
-                }
-                else {
-                    // ОБЫЧНОЕ ДВИЖЕНИЕ БЕЗ МАГНИТА
-                    coin.position.z += coin.speed * GetFrameTime();
-                }
-
-                // Деактивация монет
-                if (coin.position.z > despawnDistance) {
-                    coin.active = false;
-                }
-            }
-        }
-
-        coins.erase(std::remove_if(coins.begin(), coins.end(),
-            [](const Coin& c) { return !c.active; }), coins.end());
-    }
-
-    void SpawnCoin() {
-        Coin coin;
-        // ИСПРАВЛЕНИЕ: используем новую дальность спавна
-        coin.position = { lanePositions[GetRandomValue(0, 2)], 1.5f, spawnDistance };
-        coin.active = true;
-        // Монеты теперь имеют ту же скорость, что и препятствия
-        coin.speed = gameSpeed + (static_cast<float>(score) / 1000.0f);
-
-        coins.push_back(coin);
-    }
-
-    void UpdatePowerUps() {
-        // Спавн усилений
-        powerUpSpawnTimer += GetFrameTime();
-        if (powerUpSpawnTimer >= powerUpSpawnInterval) {
-            SpawnPowerUp();
-            powerUpSpawnTimer = 0;
-        }
-
-        // Обновление позиций и анимации усилений
-        for (auto& powerUp : powerUps) {
-            if (powerUp.active) {
-                // Усиления также движутся с увеличивающейся скоростью
-                powerUp.speed = gameSpeed + (static_cast<float>(score) / 1000.0f);
-                powerUp.position.z += powerUp.speed * GetFrameTime();
-                powerUp.rotation += 2.0f * GetFrameTime();
-
-                // ИСПРАВЛЕНИЕ: используем новую дальность деактивации
-                if (powerUp.position.z > despawnDistance) {
-                    powerUp.active = false;
-                }
-            }
-        }
-
-        powerUps.erase(std::remove_if(powerUps.begin(), powerUps.end(),
-            [](const PowerUp& p) { return !p.active; }), powerUps.end());
-    }
-
-    void SpawnPowerUp() {
-        PowerUp powerUp;
-        // ИСПРАВЛЕНИЕ: используем новую дальность спавна
-        powerUp.position = { lanePositions[GetRandomValue(0, 2)], 1.5f, spawnDistance };
-        powerUp.active = true;
-        // Усиления также имеют увеличивающуюся скорость
-        powerUp.speed = gameSpeed + (static_cast<float>(score) / 1000.0f);
-        powerUp.rotation = 0.0f;
-
-        int powerUpType = GetRandomValue(0, 3);
-        switch (powerUpType) {
-        case 0:
-            powerUp.type = PowerUpType::SPEED_BOOST;
-            break;
-        case 1:
-            powerUp.type = PowerUpType::INVINCIBILITY;
-            break;
-        case 2:
-            powerUp.type = PowerUpType::MAGNET;
-            break;
-        case 3:
-            powerUp.type = PowerUpType::DOUBLE_POINTS;
-            break;
-        }
-
-        // Назначаем текстуру способности (одинаковую на всех локациях)
-        powerUp.texture = GetPowerUpTexture(powerUp.type);
-
-        powerUps.push_back(powerUp);
-    }
-
-    void ApplyPowerUp(PowerUpType type) {
-        float baseDuration = 5.0f;
-        float upgradeBonus = 0.0f;
-
-        switch (type) {
-        case PowerUpType::SPEED_BOOST:
-            upgradeBonus = shop.upgrades[0].value;
-            break;
-        case PowerUpType::INVINCIBILITY:
-            upgradeBonus = shop.upgrades[1].value;
-            break;
-        case PowerUpType::MAGNET:
-            upgradeBonus = shop.upgrades[2].value;
-            // УВЕЛИЧИВАЕМ БАЗОВУЮ ДЛИТЕЛЬНОСТЬ ДЛЯ МАГНИТА
-            baseDuration = 8.0f; // Еще больше увеличили длительность
-            break;
-        case PowerUpType::DOUBLE_POINTS:
-            upgradeBonus = shop.upgrades[3].value;
-            break;
-        }
-
-        float totalDuration = baseDuration + upgradeBonus;
-
-        // ОСОБЫЙ СЛУЧАЙ ДЛЯ МАГНИТА - СБРАСЫВАЕМ ТАЙМЕР ПРИ ПОВТОРНОМ ПОДБОРЕ
-        if (type == PowerUpType::MAGNET) {
-            for (auto it = player.activePowerUps.begin(); it != player.activePowerUps.end(); ) {
-                if (it->type == PowerUpType::MAGNET) {
-                    it = player.activePowerUps.erase(it);
-                }
-                else {
-                    ++it;
-                }
-            }
-        }
-        else {
-            // Для остальных усилений ищем существующее
-            for (auto& activePowerUp : player.activePowerUps) {
-                if (activePowerUp.type == type) {
-                    activePowerUp.timer = totalDuration;
-                    return;
-                }
-            }
-        }
-
-        ActivePowerUp newPowerUp;
-        newPowerUp.type = type;
-        newPowerUp.timer = totalDuration;
-        newPowerUp.duration = totalDuration;
-        player.activePowerUps.push_back(newPowerUp);
-
-        if (type == PowerUpType::SPEED_BOOST) {
-            player.speed = player.originalSpeed * 1.5f;
-        }
-    }
-
-    bool HasPowerUp(PowerUpType type) {
-        for (const auto& activePowerUp : player.activePowerUps) {
-            if (activePowerUp.type == type) {
-                return true;
-            }
-        }
-        return false;
-    }
-
-    void UpdatePowerUpEffects() {
-        for (auto it = player.activePowerUps.begin(); it != player.activePowerUps.end(); ) {
-            it->timer -= GetFrameTime();
-
-            if (it->timer <= 0) {
-                if (it->type == PowerUpType::SPEED_BOOST) {
-                    player.speed = player.originalSpeed;
-                }
-                it = player.activePowerUps.erase(it);
-            }
-            else {
-                ++it;
-            }
-        }
-    }
-
     void UpdateCamera() {
-        camera.target = { player.position.x, player.position.y, player.position.z };
-        camera.position = { player.position.x, player.position.y + 3.0f, player.position.z + 8.0f };
-    }
-
-    void CheckCollisions() {
-        // Используем bounding box только для передней грани игрока
-        BoundingBox playerFrontBox = GetPlayerFrontFaceBox();
-
-        // Сбрасываем статус нахождения на препятствии
-        bool wasOnObstacle = player.isOnObstacle;
-        player.isOnObstacle = false;
-
-        for (auto& obstacle : obstacles) {
-            if (obstacle.active && player.lane == obstacle.lane) {
-                // Используем bounding box только для передней грани препятствия
-                BoundingBox obstacleFrontBox = GetObstacleFrontFaceBox(obstacle);
-
-                if (CheckCollisionBoxes(playerFrontBox, obstacleFrontBox)) {
-                    if (HasPowerUp(PowerUpType::INVINCIBILITY)) {
-                        continue;
-                    }
-
-                    // Проверяем, находимся ли мы СВЕРХУ препятствия
-                    float playerBottom = player.position.y - player.size.y / 2;
-                    float obstacleTop = obstacle.position.y + obstacle.size.y / 2;
-
-                    if (playerBottom >= obstacleTop - 0.1f && obstacle.canLandOn) {
-                        // Игрок стоит сверху на препятствии
-                        player.isOnObstacle = true;
-                        continue; // Не считаем это столкновением
-                    }
-
-                    bool canAvoid = false;
-
-                    switch (obstacle.type) {
-                    case ObstacleType::JUMP_OVER:
-                        // JUMP OVER: можно перепрыгнуть, но нельзя пригнуться
-                        canAvoid = player.isJumping && !player.isRolling;
-                        break;
-                    case ObstacleType::DUCK_UNDER:
-                        // DUCK UNDER: можно пригнуться, но нельзя перепрыгнуть
-                        // ИЗМЕНЕНО: теперь kill zone такая же как у JUMP_OVER
-                        canAvoid = player.isRolling && !player.isJumping;
-                        break;
-                    case ObstacleType::WALL:
-                        canAvoid = false;
-                        break;
-                    case ObstacleType::LOW_BARRIER:
-                        // LOW BARRIER: нельзя перепрыгнуть, можно ТОЛЬКО пригнуться
-                        canAvoid = player.isRolling && !player.isJumping;
-                        break;
-                    }
-
-                    if (!canAvoid) {
-                        // НОВОЕ: вместо мгновенного gameOver запускаем анимацию падения
-                        player.isFalling = true;
-                        player.fallTimer = 0.0f;
-                        player.fallRotation = 0.0f;
-                        gameOver = true;
-                        return;
-                    }
-                }
-            }
-        }
-
-        // Если был на препятствии, но больше нет - сбрасываем высоту
-        if (wasOnObstacle && !player.isOnObstacle && !player.isJumping) {
-            player.position.y = 1.0f;
-        }
-
-        for (auto& coin : coins) {
-            if (coin.active) {
-                // Для монет используем обычную проверку сферы
-                if (CheckCollisionBoxSphere(playerFrontBox, coin.position, 0.5f)) {
-                    coin.active = false;
-                    coinsCollected++;
-                    int coinValue = 100 + static_cast<int>(shop.upgrades[4].value);
-                    score += HasPowerUp(PowerUpType::DOUBLE_POINTS) ? coinValue * 2 : coinValue;
-                }
-            }
+        const Player& player = sim.GetPlayer();
+        Vector3 playerPosition = Interpolate(player.previousPosition, player.position);
+        camera.target = { playerPosition.x, playerPosition.y, playerPosition.z };
+        if (sim.GetCrowd().GetSize() > 0) {
+            // Забег толпой: камера выше и дальше, чтобы толпа была видна
+            camera.position = { playerPosition.x, playerPosition.y + 9.0f, playerPosition.z + 18.0f };
         }
-
-        for (auto& powerUp : powerUps) {
-            if (powerUp.active) {
-                // Для усилений используем обычную проверку сферы
-                if (CheckCollisionBoxSphere(playerFrontBox, powerUp.position, 0.5f)) {
-                    powerUp.active = false;
-                    ApplyPowerUp(powerUp.type);
-                }
-            }
+        else {
+            camera.position = { playerPosition.x, playerPosition.y + 3.0f, playerPosition.z + 8.0f };
         }
     }
 
-    // ОБНОВЛЕННАЯ ФУНКЦИЯ: сброса игры
-    void ResetGame() {
-        player.position = { lanePositions[1], 1.0f, 0.0f };
-        player.lane = 1;
-        player.targetLane = 1;
-        player.isJumping = false;
-        player.isRolling = false;
-        player.jumpVelocity = 0;
-        player.speed = player.originalSpeed;
-        player.isOnObstacle = false;
-        player.rollCooldownTimer = 0.0f;
-        player.rollDuration = 0.0f;
-        player.isFalling = false;
-        player.fallTimer = 0.0f;
-        player.fallRotation = 0.0f;
-
-        // Сброс компаньона
-        companion.position = { lanePositions[1], 1.0f, player.position.z + companion.followDistance };
-        companion.lane = 1;
-        companion.targetLane = 1;
-        companion.isJumping = false;
-        companion.isRolling = false;
-        companion.jumpVelocity = 0;
-        companion.isOnObstacle = false;
-        companion.size = companion.originalSize; // Восстанавливаем оригинальный размер
-        companion.followBehindTimer = 5.0f; // 5 секунд бежим ВМЕСТЕ с игроком
-        companion.catchUpTimer = 0.0f;
-        companion.isCatchingUp = false;
-
-        obstacles.clear();
-        coins.clear();
-        powerUps.clear();
-        player.activePowerUps.clear();
-
-        score = 0;
-        gameOver = false;
-        environmentOffset = 0.0f;
-    }
-
     void Draw3DWorld() {
-        DrawPlane({ 0.0f, 0.0f, 0.0f }, { 50.0f, 100.0f }, GetCurrentGroundColor());
+        const Player& player = sim.GetPlayer();
 
-        // НОВОЕ: рисуем три отдельные полосы с разными цветами
-        for (int i = 0; i < 3; i++) {
-            Color laneColor;
-            switch (i) {
-            case 0: laneColor = GetLeftLaneColor(); break;
-            case 1: laneColor = GetMiddleLaneColor(); break;
-            case 2: laneColor = GetRightLaneColor(); break;
-            }
-            DrawCube({ lanePositions[i], 0.01f, 0.0f }, laneWidth, 0.02f, 100.0f, laneColor);
+        float groundWidth = std::max(50.0f, 2.0f * GetEnvironmentX() + 34.0f);
+        DrawPlane({ 0.0f, 0.0f, 0.0f }, { groundWidth, 100.0f }, GetCurrentGroundColor());
+
+        // Полосы трассы с разными цветами
+        for (int i = 0; i < sim.GetLaneCount(); i++) {
+            DrawCube({ ToFloat(sim.GetLanePosition(i)), 0.01f, 0.0f }, ToFloat(sim.GetLaneWidth()), 0.02f, 100.0f, GetLaneColor(i));
         }
 
         // Рисуем окружение с учетом локации
         DrawEnvironment();
 
         // Рисуем препятствия с текстурами
-        for (auto& obstacle : obstacles) {
-            DrawObstacle(obstacle);
+        const ObstacleStore& obstacles = sim.GetObstacles();
+        for (size_t i = 0; i < obstacles.GetCount(); i++) {
+            DrawObstacle(obstacles.Get(i));
         }
 
-        for (auto& coin : coins) {
-            if (coin.active) {
-                DrawSphere(coin.position, 0.5f, GOLD);
+        const CoinStore& coins = sim.GetCoins();
+        for (size_t i = 0; i < coins.GetCount(); i++) {
+            if (coins.IsActive(i)) {
+                DrawSphere(Interpolate(coins.GetPreviousPosition(i), coins.GetPosition(i)), 0.5f, GOLD);
             }
         }
 
         // Рисуем способности с текстурами
-        for (auto& powerUp : powerUps) {
-            DrawPowerUp(powerUp);
+        const PowerUpStore& powerUps = sim.GetPowerUps();
+        for (size_t i = 0; i < powerUps.GetCount(); i++) {
+            DrawPowerUp(powerUps.Get(i));
         }
 
         // ИСПРАВЛЕНО: рисуем компаньона ПОСЛЕ игрока (чтобы он был СЗАДИ)
@@ -2284,65 +1720,75 @@ private:
         // КОМПАНЬОН НЕ РИСУЕТСЯ ПРИ ПАДЕНИИ ИГРОКА
         if (!player.isFalling) {
             DrawCompanion();
+            DrawCrowd();
         }
 
-        if (HasPowerUp(PowerUpType::MAGNET)) {
+        if (sim.HasPowerUp(PowerUpType::MAGNET)) {
             float magnetRadius = 2.0f + (shop.upgrades[2].level * 0.3f);
         }
     }
 
     void DrawPlayer() {
+        const Player& player = sim.GetPlayer();
+
         // НОВОЕ: если персонаж падает, рисуем специальную анимацию
         if (player.isFalling) {
             DrawFallingPlayer();
             return;
         }
 
+        Vector3 drawPosition = Interpolate(player.previousPosition, player.position);
+
         // Если для текущего персонажа доступна анимированная текстура и она загружена
-        if (menu.characters[player.characterType].useAnimatedTexture &&
-            characterAnimations[player.characterType].loaded) {
+        if (menu.characters[characterType].useAnimatedTexture &&
+            characterAnimations[characterType].loaded) {
 
-            AnimatedTexture& animTex = characterAnimations[player.characterType];
+            AnimatedTexture& animTex = characterAnimations[characterType];
+            Vector3 playerSize = ToVector3(player.size);
             Vector3 scaledSize = {
-                player.size.x * animTex.scale,
-                player.size.y * animTex.scale,
-                player.size.z * animTex.scale
+                playerSize.x * animTex.scale,
+                playerSize.y * animTex.scale,
+                playerSize.z * animTex.scale
             };
 
             // Используем текущий кадр анимации
             Texture2D currentFrame = GetCurrentFrame(animTex);
-            DrawCubeTexture(player.position, scaledSize, currentFrame, WHITE);
+            DrawCubeTexture(drawPosition, scaledSize, currentFrame, WHITE);
         }
         else {
             // Fallback: используем статичную текстуру или цветной куб
             Texture2D characterTexture = GetCharacterTexture();
 
             if (IsTextureReady(characterTexture)) {
-                DrawCubeTexture(player.position, player.size, characterTexture, RAYWHITE);
+                DrawCubeTexture(drawPosition, ToVector3(player.size), characterTexture, RAYWHITE);
             }
             else {
-                Color playerColor = menu.characters[player.characterType].defaultColor;
-                if (HasPowerUp(PowerUpType::INVINCIBILITY) && ((int)(GetTime() * 10) % 2 == 0)) {
+                Color playerColor = menu.characters[characterType].defaultColor;
+                if (sim.HasPowerUp(PowerUpType::INVINCIBILITY) && ((int)(GetTime() * 10) % 2 == 0)) {
                     playerColor = GOLD;
                 }
-                DrawCube(player.position, player.size.x, player.size.y, player.size.z, playerColor);
-                DrawCubeWires(player.position, player.size.x, player.size.y, player.size.z, BLACK);
+                Vector3 playerSize = ToVector3(player.size);
+                DrawCube(drawPosition, playerSize.x, playerSize.y, playerSize.z, playerColor);
+                DrawCubeWires(drawPosition, playerSize.x, playerSize.y, playerSize.z, BLACK);
             }
         }
     }
 
     void DrawFallingPlayer() {
+        const Player& player = sim.GetPlayer();
+
         // Сохраняем текущую матрицу преобразования
         rlPushMatrix();
 
         // Перемещаемся к позиции персонажа
-        rlTranslatef(player.position.x, player.position.y, player.position.z);
+        Vector3 drawPosition = Interpolate(player.previousPosition, player.position);
+        rlTranslatef(drawPosition.x, drawPosition.y, drawPosition.z);
 
         // Вращаем персонажа в зависимости от состояния падения
-        rlRotatef(player.fallRotation, 0.0f, 0.0f, 1.0f);
+        rlRotatef(ToFloat(player.fallRotation), 0.0f, 0.0f, 1.0f);
 
         // ИСПРАВЛЕНИЕ: значительно увеличенные размеры для лежачего персонажа
-        Vector3 fallSize = { player.size.x * 2.0f, 0.8f, player.size.y * 1.5f };
+        Vector3 fallSize = { ToFloat(player.size.x) * 2.0f, 0.8f, ToFloat(player.size.y) * 1.5f };
 
         // ИСПРАВЛЕНИЕ: используем текстуру падения текущего персонажа
         Texture2D currentFallTexture = GetCurrentFallTexture();
@@ -2352,7 +1798,7 @@ private:
         }
         else {
             // Fallback если текстура не загружена
-            Color fallColor = menu.characters[player.characterType].defaultColor;
+            Color fallColor = menu.characters[characterType].defaultColor;
             DrawCube({ 0, 0, 0 }, fallSize.x, fallSize.y, fallSize.z, fallColor);
             DrawCubeWires({ 0, 0, 0 }, fallSize.x, fallSize.y, fallSize.z, BLACK);
         }
@@ -2412,45 +1858,58 @@ private:
     }
 
     void Draw() {
+        const Player& player = sim.GetPlayer();
+        const Companion& companion = sim.GetCompanion();
+        int score = sim.GetScore();
+        int coinsCollected = sim.GetCoinsCollected();
+
         BeginDrawing();
         ClearBackground(GetCurrentBackgroundColor());
 
-        if (menu.isActive) {
+        switch (screen) {
+        case ScreenState::MENU:
             DrawMenu();
-        }
-        else if (shop.isActive) {
+            break;
+
+        case ScreenState::SHOP:
             DrawShop();
-        }
-        else if (gameOver) {
+            break;
+
+        case ScreenState::FALLING:
             // НОВОЕ: если персонаж падает, рисуем только 3D сцену с анимацией
-            if (player.isFalling) {
-                BeginMode3D(camera);
-                BeginBlendMode(BLEND_ALPHA);
+            BeginMode3D(camera);
+            BeginBlendMode(BLEND_ALPHA);
 
-                Draw3DWorld();
+            Draw3DWorld();
 
-                EndBlendMode();
-                EndMode3D();
+            EndBlendMode();
+            EndMode3D();
 
-                // Показываем таймер падения
-                if (player.fallTimer < 5.0f) {
-                    DrawText(TextFormat("Falling... %.1f", 5.0f - player.fallTimer),
-                        screenWidth / 2 - MeasureText("Falling... 5.0", 30) / 2,
-                        50, 30, RED);
-                }
+            // Показываем таймер падения
+            if (sim.IsTimerActive(player.fallTimer)) {
+                DrawText(TextFormat("Falling... %.1f", ToFloat(sim.GetTimeLeft(player.fallTimer))),
+                    screenWidth / 2 - MeasureText("Falling... 5.0", 30) / 2,
+                    50, 30, RED);
             }
-            else {
-                // После завершения падения показываем обычное меню game over
-                DrawRectangle(0, 0, screenWidth, screenHeight, Fade(BLACK, 0.5f));
-                DrawText("GAME OVER", screenWidth / 2 - MeasureText("GAME OVER", 40) / 2, screenHeight / 2 - 80, 40, RED);
-                DrawText(TextFormat("Final Score: %d", score), screenWidth / 2 - MeasureText(TextFormat("Final Score: %d", score), 20) / 2, screenHeight / 2 - 30, 20, WHITE);
-                DrawText(TextFormat("Coins Collected: %d", coinsCollected), screenWidth / 2 - MeasureText(TextFormat("Coins Collected: %d", coinsCollected), 20) / 2, screenHeight / 2, 20, GOLD);
-                DrawText("Press R to restart", screenWidth / 2 - MeasureText("Press R to restart", 20) / 2, screenHeight / 2 + 30, 20, WHITE);
-                DrawText("Press M for menu", screenWidth / 2 - MeasureText("Press M for menu", 20) / 2, screenHeight / 2 + 60, 20, WHITE);
-                DrawText("Press S for shop", screenWidth / 2 - MeasureText("Press S for shop", 20) / 2, screenHeight / 2 + 90, 20, GREEN);
+            break;
+
+        case ScreenState::GAME_OVER:
+            // После завершения падения показываем обычное меню game over
+            DrawRectangle(0, 0, screenWidth, screenHeight, Fade(BLACK, 0.5f));
+            DrawText("GAME OVER", screenWidth / 2 - MeasureText("GAME OVER", 40) / 2, screenHeight / 2 - 80, 40, RED);
+            DrawText(TextFormat("Final Score: %d", score), screenWidth / 2 - MeasureText(TextFormat("Final Score: %d", score), 20) / 2, screenHeight / 2 - 30, 20, WHITE);
+            DrawText(TextFormat("Coins Collected: %d", coinsCollected), screenWidth / 2 - MeasureText(TextFormat("Coins Collected: %d", coinsCollected), 20) / 2, screenHeight / 2, 20, GOLD);
+            DrawText("Press R to restart", screenWidth / 2 - MeasureText("Press R to restart", 20) / 2, screenHeight / 2 + 30, 20, WHITE);
+            DrawText("Press M for menu", screenWidth / 2 - MeasureText("Press M for menu", 20) / 2, screenHeight / 2 + 60, 20, WHITE);
+            DrawText("Press S for shop", screenWidth / 2 - MeasureText("Press S for shop", 20) / 2, screenHeight / 2 + 90, 20, GREEN);
+            DrawText("Press P to watch replay", screenWidth / 2 - MeasureText("Press P to watch replay", 20) / 2, screenHeight / 2 + 120, 20, LIGHTGRAY);
+            if (rewindEnabled && !isReplaying && rewind.GetFrameCount() > 0) {
+                DrawText("Hold BACKSPACE to rewind", screenWidth / 2 - MeasureText("Hold BACKSPACE to rewind", 20) / 2, screenHeight / 2 + 150, 20, SKYBLUE);
             }
-        }
-        else {
+            break;
+
+        case ScreenState::RUNNING:
+            UpdateCamera();
             BeginMode3D(camera);
             BeginBlendMode(BLEND_ALPHA);
 
@@ -2460,28 +1919,37 @@ private:
             EndMode3D();
 
             DrawText(TextFormat("Score: %d", score), 10, 10, 20, BLACK);
+            if (isReplaying) {
+                DrawText("REPLAY", screenWidth - MeasureText("REPLAY", 30) - 10, 10, 30, RED);
+            }
+            else if (isRewinding) {
+                DrawText("<< REWIND", screenWidth - MeasureText("<< REWIND", 30) - 10, 10, 30, SKYBLUE);
+            }
             DrawText(TextFormat("Coins: %d", coinsCollected), 10, 40, 20, BLACK);
-            DrawText(TextFormat("Lane: %d", player.lane + 1), 10, 70, 20, BLACK);
+            DrawText(TextFormat("Lane: %d / %d", player.lane + 1, sim.GetLaneCount()), 10, 70, 20, BLACK);
             DrawText(TextFormat("Target Lane: %d", player.targetLane + 1), 10, 100, 15, DARKGRAY);
             DrawText(TextFormat("Location: %s", menu.locations[menu.selectedLocation].name.c_str()), 10, 120, 15, DARKGRAY);
-            DrawText(TextFormat("Character: %s", menu.characters[player.characterType].name.c_str()), 10, 140, 15, DARKGRAY);
+            DrawText(TextFormat("Character: %s", menu.characters[characterType].name.c_str()), 10, 140, 15, DARKGRAY);
 
             // НОВОЕ: отображение информации о компаньоне
             DrawText(TextFormat("Companion: %s",
                 companion.isCatchingUp ? "CATCHING UP" :
-                (companion.followBehindTimer > 0 ? "RUNNING TOGETHER" : "FALLING BEHIND")),
+                (companion.isFallingBehind ? "FALLING BEHIND" : "RUNNING TOGETHER")),
                 10, 170, 15, DARKGRAY);
 
             int powerUpY = 190;
-            if (!player.activePowerUps.empty()) {
+            if (player.activePowerUps != 0) {
                 DrawText("ACTIVE POWER-UPS:", 10, powerUpY, 15, DARKPURPLE);
                 powerUpY += 20;
 
-                for (const auto& activePowerUp : player.activePowerUps) {
+                for (int i = 0; i < powerUpTypeCount; i++) {
+                    PowerUpType type = static_cast<PowerUpType>(i);
+                    if (!sim.HasPowerUp(type)) continue;
+
                     std::string powerUpName;
                     Color powerUpColor;
 
-                    switch (activePowerUp.type) {
+                    switch (type) {
                     case PowerUpType::SPEED_BOOST:
                         powerUpName = "SPEED BOOST";
                         powerUpColor = ORANGE;
@@ -2500,7 +1968,7 @@ private:
                         break;
                     }
 
-                    DrawText(TextFormat("%s: %.1fs", powerUpName.c_str(), activePowerUp.timer),
+                    DrawText(TextFormat("%s: %.1fs", powerUpName.c_str(), ToFloat(sim.GetTimeLeft(player.powerUps[i].timer))),
                         10, powerUpY, 15, powerUpColor);
                     powerUpY += 20;
                 }
@@ -2508,7 +1976,7 @@ private:
 
             // ИСПРАВЛЕНО: правильное использование TextFormat
             char rollText[64];
-            snprintf(rollText, sizeof(rollText), "ROLL: DOWN (Cooldown: %.1fs)", player.rollCooldownTimer);
+            snprintf(rollText, sizeof(rollText), "ROLL: DOWN (Cooldown: %.1fs)", ToFloat(sim.GetTimeLeft(player.rollCooldownTimer)));
             DrawText("JUMP: SPACE/UP", 10, powerUpY, 15, DARKGREEN);
             DrawText(rollText, 10, powerUpY + 20, 15, DARKBLUE);
             DrawText("MOVE: LEFT/RIGHT", 10, powerUpY + 40, 15, DARKPURPLE);
@@ -2525,6 +1993,7 @@ private:
             DrawText("★ - Invincibility", 10, powerUpY + 210, 12, GOLD);
             DrawText("🧲 - Coin Magnet", 10, powerUpY + 225, 12, BLUE);
             DrawText("2X - Double Points", 10, powerUpY + 240, 12, GREEN);
+            break;
         }
 
         EndDrawing();
@@ -2548,6 +2017,14 @@ private:
             DrawText(menu.characters[i].name.c_str(), screenWidth / 2 - MeasureText(menu.characters[i].name.c_str(), 25) / 2, 400 + i * 40, 25, color);
         }
 
+        const char* crowdText = crowdSizes[crowdSizeIndex] > 0
+            ? TextFormat("CROWD RUN: %d FOLLOWERS (C to change)", crowdSizes[crowdSizeIndex])
+            : "CROWD RUN: OFF (C to change)";
+        DrawText(crowdText, screenWidth / 2 - MeasureText(crowdText, 20) / 2, 660, 20, SKYBLUE);
+
+        const char* laneText = TextFormat("TRACK: %d LANES (L to change)", laneCount);
+        DrawText(laneText, screenWidth / 2 - MeasureText(laneText, 20) / 2, 690, 20, SKYBLUE);
+
         DrawText("PRESS ENTER TO START", screenWidth / 2 - MeasureText("PRESS ENTER TO START", 30) / 2, 550, 30, YELLOW);
         DrawText("USE ARROWS TO NAVIGATE", screenWidth / 2 - MeasureText("USE ARROWS TO NAVIGATE", 20) / 2, 600, 20, LIGHTGRAY);
         DrawText("PRESS S FOR UPGRADE SHOP", screenWidth / 2 - MeasureText("PRESS S FOR UPGRADE SHOP", 20) / 2, 630, 20, LIME);
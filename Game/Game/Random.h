@@ -0,0 +1,80 @@
+﻿#pragma once
+
+#include <cstdint>
+
+// Быстрый детерминированный генератор xoshiro128** (Blackman, Vigna).
+// Одинаковые seed и stream дают одинаковую последовательность на любой
+// платформе, поэтому его можно использовать для воспроизводимых забегов.
+class Random {
+public:
+    Random() { Seed(0, 0); }
+    Random(uint64_t seed, uint64_t stream) { Seed(seed, stream); }
+
+    // Независимые потоки получаются из одного seed через разный номер потока
+    void Seed(uint64_t seed, uint64_t stream) {
+        uint64_t x = seed ^ (stream * 0xD1B54A32D192ED03ull);
+        for (int i = 0; i < 4; i += 2) {
+            uint64_t value = SplitMix64(x);
+            state[i] = static_cast<uint32_t>(value);
+            state[i + 1] = static_cast<uint32_t>(value >> 32);
+        }
+        // Нулевое состояние у xoshiro недопустимо
+        if ((state[0] | state[1] | state[2] | state[3]) == 0) {
+            state[0] = 1;
+        }
+    }
+
+    uint32_t NextUInt() {
+        const uint32_t result = Rotl(state[1] * 5, 7) * 9;
+        const uint32_t t = state[1] << 9;
+
+        state[2] ^= state[0];
+        state[3] ^= state[1];
+        state[1] ^= state[2];
+        state[0] ^= state[3];
+        state[2] ^= t;
+        state[3] = Rotl(state[3], 11);
+
+        return result;
+    }
+
+    // Целое в диапазоне [min, max] включительно (как GetRandomValue в raylib)
+    int Int(int min, int max) {
+        uint32_t range = static_cast<uint32_t>(max - min) + 1;
+        if (range == 0) {
+            return static_cast<int>(NextUInt());
+        }
+        // Отбрасываем хвост, чтобы распределение было равномерным
+        uint32_t limit = UINT32_MAX - UINT32_MAX % range;
+        uint32_t value;
+        do {
+            value = NextUInt();
+        } while (value >= limit);
+        return min + static_cast<int>(value % range);
+    }
+
+    // Число в диапазоне [0, 1)
+    float Float() {
+        return static_cast<float>(NextUInt() >> 8) * (1.0f / 16777216.0f);
+    }
+
+    // Состояние генератора для снимков (см. Snapshot.h)
+    template <typename Archive>
+    void Serialize(Archive& archive) {
+        for (uint32_t& word : state) archive(word);
+    }
+
+private:
+    uint32_t state[4];
+
+    static uint32_t Rotl(uint32_t x, int k) {
+        return (x << k) | (x >> (32 - k));
+    }
+
+    static uint64_t SplitMix64(uint64_t& x) {
+        uint64_t z = (x += 0x9E3779B97F4A7C15ull);
+        z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+        z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+        return z ^ (z >> 31);
+    }
+};
@@ -0,0 +1,215 @@
+﻿#include "Replay.h"
+#include <fstream>
+#include <iterator>
+
+void ReplayRecorder::Begin(const Simulation& sim, uint16_t tickRate) {
+    replay = Replay();
+    replay.tickRate = tickRate;
+    replay.seed = sim.GetSeed();
+    for (int i = 0; i < upgradeCount; i++) {
+        replay.upgradeLevels[i] = static_cast<uint8_t>(sim.GetUpgradeLevel(static_cast<UpgradeType>(i)));
+    }
+    replay.laneCount = static_cast<uint8_t>(sim.GetLaneCount());
+    replay.difficultyHash = sim.GetDifficultyCurve().GetHash();
+    recording = true;
+}
+
+void ReplayRecorder::Record(uint32_t tick, const InputState& input) {
+    if (!recording) return;
+
+    uint8_t buttons = PackInput(input);
+    if (buttons == 0) return;
+
+    ReplayEvent event;
+    event.tick = tick;
+    event.buttons = buttons;
+    replay.events.push_back(event);
+}
+
+const Replay& ReplayRecorder::Finish(uint32_t tickCount, int finalScore) {
+    replay.tickCount = tickCount;
+    replay.finalScore = static_cast<uint32_t>(finalScore);
+    recording = false;
+    return replay;
+}
+
+void ReplayPlayer::Start(const Replay& newReplay, Simulation& sim) {
+    replay = &newReplay;
+    nextEvent = 0;
+
+    for (int i = 0; i < upgradeCount; i++) {
+        sim.SetUpgradeLevel(static_cast<UpgradeType>(i), replay->upgradeLevels[i]);
+    }
+    sim.SetLaneCount(replay->laneCount);
+    sim.Reset(replay->seed);
+}
+
+InputState ReplayPlayer::NextInput(uint32_t tick) {
+    uint8_t buttons = 0;
+    if (replay) {
+        // Пропускаем события, которые уже в прошлом (их тики не выполнялись)
+        while (nextEvent < replay->events.size() && replay->events[nextEvent].tick < tick) {
+            nextEvent++;
+        }
+        if (nextEvent < replay->events.size() && replay->events[nextEvent].tick == tick) {
+            buttons = replay->events[nextEvent].buttons;
+            nextEvent++;
+        }
+    }
+    return UnpackInput(buttons);
+}
+
+bool ReplayPlayer::IsFinished(uint32_t tick) const {
+    return !replay || tick >= replay->tickCount;
+}
+
+// Низкоуровневое кодирование: целые в little-endian и varint (LEB128)
+static void WriteU8(std::vector<uint8_t>& out, uint8_t value) {
+    out.push_back(value);
+}
+
+static void WriteU16(std::vector<uint8_t>& out, uint16_t value) {
+    out.push_back(static_cast<uint8_t>(value));
+    out.push_back(static_cast<uint8_t>(value >> 8));
+}
+
+static void WriteU64(std::vector<uint8_t>& out, uint64_t value) {
+    for (int i = 0; i < 8; i++) {
+        out.push_back(static_cast<uint8_t>(value >> (i * 8)));
+    }
+}
+
+static void WriteVarint(std::vector<uint8_t>& out, uint32_t value) {
+    while (value >= 0x80) {
+        out.push_back(static_cast<uint8_t>(value | 0x80));
+        value >>= 7;
+    }
+    out.push_back(static_cast<uint8_t>(value));
+}
+
+// Читатель с проверкой границ: после первой ошибки ok == false
+struct ByteReader {
+    const uint8_t* data;
+    size_t size;
+    size_t position;
+    bool ok;
+
+    bool Need(size_t count) {
+        if (!ok || size - position < count) ok = false;
+        return ok;
+    }
+
+    uint8_t U8() {
+        if (!Need(1)) return 0;
+        return data[position++];
+    }
+
+    uint16_t U16() {
+        if (!Need(2)) return 0;
+        uint16_t value = static_cast<uint16_t>(data[position] | (data[position + 1] << 8));
+        position += 2;
+        return value;
+    }
+
+    uint64_t U64() {
+        if (!Need(8)) return 0;
+        uint64_t value = 0;
+        for (int i = 0; i < 8; i++) {
+            value |= static_cast<uint64_t>(data[position + i]) << (i * 8);
+        }
+        position += 8;
+        return value;
+    }
+
+    uint32_t Varint() {
+        uint32_t value = 0;
+        for (int shift = 0; shift < 35; shift += 7) {
+            uint8_t byte = U8();
+            if (!ok) return 0;
+            value |= static_cast<uint32_t>(byte & 0x7F) << shift;
+            if ((byte & 0x80) == 0) return value;
+        }
+        ok = false; // Слишком длинное число
+        return 0;
+    }
+};
+
+static const uint8_t replayMagic[4] = { 'R', 'N', 'R', 'P' };
+
+void WriteReplay(const Replay& replay, std::vector<uint8_t>& out) {
+    out.clear();
+    out.reserve(40 + replay.events.size() * 3);
+
+    for (uint8_t byte : replayMagic) WriteU8(out, byte);
+    WriteU16(out, replayVersion);
+    WriteU16(out, replay.tickRate);
+    WriteU8(out, replayNumberFormat);
+    WriteU64(out, replay.seed);
+    for (int i = 0; i < upgradeCount; i++) WriteU8(out, replay.upgradeLevels[i]);
+    WriteU8(out, replay.laneCount);
+    WriteU64(out, replay.difficultyHash);
+    WriteVarint(out, replay.tickCount);
+    WriteVarint(out, replay.finalScore);
+    WriteVarint(out, static_cast<uint32_t>(replay.events.size()));
+
+    uint32_t previousTick = 0;
+    for (const auto& event : replay.events) {
+        WriteVarint(out, event.tick - previousTick);
+        WriteU8(out, event.buttons);
+        previousTick = event.tick;
+    }
+}
+
+bool ReadReplay(const uint8_t* data, size_t size, Replay& replay) {
+    ByteReader reader = { data, size, 0, true };
+
+    for (uint8_t byte : replayMagic) {
+        if (reader.U8() != byte) return false;
+    }
+    if (reader.U16() != replayVersion) return false;
+
+    Replay result;
+    result.tickRate = reader.U16();
+    if (reader.U8() != replayNumberFormat) return false;
+    result.seed = reader.U64();
+    for (int i = 0; i < upgradeCount; i++) result.upgradeLevels[i] = reader.U8();
+    result.laneCount = reader.U8();
+    if (result.laneCount < minLaneCount || result.laneCount > maxLaneCount) return false;
+    result.difficultyHash = reader.U64();
+    result.tickCount = reader.Varint();
+    result.finalScore = reader.Varint();
+    uint32_t eventCount = reader.Varint();
+
+    // Каждое событие занимает минимум 2 байта - не доверяем счетчику из файла
+    if (!reader.ok || eventCount > (size - reader.position) / 2) return false;
+    result.events.resize(eventCount);
+
+    uint32_t tick = 0;
+    for (auto& event : result.events) {
+        tick += reader.Varint();
+        event.tick = tick;
+        event.buttons = reader.U8();
+    }
+    if (!reader.ok) return false;
+
+    replay = result;
+    return true;
+}
+
+bool SaveReplay(const Replay& replay, const std::string& path) {
+    std::vector<uint8_t> bytes;
+    WriteReplay(replay, bytes);
+
+    std::ofstream file(path, std::ios::binary | std::ios::trunc);
+    if (!file) return false;
+    file.write(reinterpret_cast<const char*>(bytes.data()), static_cast<std::streamsize>(bytes.size()));
+    return static_cast<bool>(file);
+}
+
+bool LoadReplay(const std::string& path, Replay& replay) {
+    std::ifstream file(path, std::ios::binary);
+    if (!file) return false;
+
+    std::vector<uint8_t> bytes((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+    return ReadReplay(bytes.data(), bytes.size(), replay);
+}
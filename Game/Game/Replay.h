@@ -0,0 +1,107 @@
+﻿#pragma once
+
+#include "Simulation.h"
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Запись и воспроизведение забегов.
+// Симуляция детерминирована, поэтому для повтора достаточно seed, уровней
+// улучшений, кривой сложности и нажатий с номерами тиков - состояние мира
+// не сохраняется.
+//
+// Формат файла (little-endian), версия 5:
+//   "RNRP"                 - сигнатура
+//   uint16 version
+//   uint16 tickRate        - частота тиков, с которой записан забег
+//   uint8  numberFormat    - арифметика симуляции (ReplayNumberFormat)
+//   uint64 seed
+//   uint8  upgradeLevels[upgradeCount]
+//   uint8  laneCount       - число полос трассы
+//   uint64 difficultyHash  - DifficultyCurve::GetHash() кривой забега
+//   varint tickCount       - длина забега в тиках
+//   varint finalScore      - очки на последнем тике (проверка при проигрывании)
+//   varint eventCount
+//   события: varint (тик - тик предыдущего события), uint8 кнопки (InputBit)
+// Одно нажатие занимает 2-3 байта, минутный забег - несколько сотен байт.
+
+const uint16_t replayVersion = 5;
+
+// Повтор из float-сборки в fixed-сборке (и наоборот) разойдется - такие
+// файлы не читаются
+enum ReplayNumberFormat : uint8_t {
+    REPLAY_FLOAT = 0,
+    REPLAY_FIXED_Q16_16 = 1
+};
+
+#ifdef GAME_FIXED_POINT
+const uint8_t replayNumberFormat = REPLAY_FIXED_Q16_16;
+#else
+const uint8_t replayNumberFormat = REPLAY_FLOAT;
+#endif
+
+// Нажатия, поданные в Step при sim.GetTick() == tick (пустые тики не пишутся)
+struct ReplayEvent {
+    uint32_t tick;
+    uint8_t buttons;
+};
+
+struct Replay {
+    uint16_t tickRate;
+    uint64_t seed;
+    uint8_t upgradeLevels[upgradeCount];
+    uint8_t laneCount;
+    uint64_t difficultyHash;
+    uint32_t tickCount;
+    uint32_t finalScore;
+    std::vector<ReplayEvent> events;
+
+    Replay() : tickRate(0), seed(0), laneCount(3), difficultyHash(0), tickCount(0), finalScore(0) {
+        for (int i = 0; i < upgradeCount; i++) upgradeLevels[i] = 1;
+    }
+};
+
+// Копит нажатия текущего забега
+class ReplayRecorder {
+public:
+    ReplayRecorder() : recording(false) {}
+
+    // Начало забега: sim уже сброшен с нужным seed и уровнями улучшений
+    void Begin(const Simulation& sim, uint16_t tickRate);
+    // Вызывается перед sim.Step с tick = sim.GetTick()
+    void Record(uint32_t tick, const InputState& input);
+    const Replay& Finish(uint32_t tickCount, int finalScore);
+    void Cancel() { recording = false; }
+
+    bool IsRecording() const { return recording; }
+    const Replay& GetReplay() const { return replay; }
+
+private:
+    Replay replay;
+    bool recording;
+};
+
+// Подает записанные нажатия вместо клавиатуры
+class ReplayPlayer {
+public:
+    ReplayPlayer() : replay(nullptr), nextEvent(0) {}
+
+    // Сбрасывает sim к началу записанного забега
+    void Start(const Replay& replay, Simulation& sim);
+    // Ввод для ближайшего sim.Step, tick = sim.GetTick()
+    InputState NextInput(uint32_t tick);
+    bool IsFinished(uint32_t tick) const;
+
+private:
+    const Replay* replay;
+    size_t nextEvent;
+};
+
+// Сериализация в память и в файл. Возвращают false при ошибке
+// ввода-вывода, чужой сигнатуре, неизвестной версии, другой арифметике
+// или обрезанных данных
+void WriteReplay(const Replay& replay, std::vector<uint8_t>& out);
+bool ReadReplay(const uint8_t* data, size_t size, Replay& replay);
+bool SaveReplay(const Replay& replay, const std::string& path);
+bool LoadReplay(const std::string& path, Replay& replay);
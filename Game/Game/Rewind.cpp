@@ -0,0 +1,233 @@
+﻿#include "Rewind.h"
+#include <cstring>
+
+// Кодирование дельты: varint размер снимка, затем пары
+// (varint длина серии нулей, varint длина литерала, байты литерала),
+// где байты - XOR текущего снимка с ключевым кадром
+
+static size_t WriteVarint(uint8_t* out, uint32_t value) {
+    size_t count = 0;
+    while (value >= 0x80) {
+        out[count++] = static_cast<uint8_t>(value | 0x80);
+        value >>= 7;
+    }
+    out[count++] = static_cast<uint8_t>(value);
+    return count;
+}
+
+static uint32_t ReadVarint(const uint8_t* data, size_t size, size_t& position) {
+    uint32_t value = 0;
+    for (int shift = 0; shift < 35 && position < size; shift += 7) {
+        uint8_t byte = data[position++];
+        value |= static_cast<uint32_t>(byte & 0x7F) << shift;
+        if ((byte & 0x80) == 0) break;
+    }
+    return value;
+}
+
+// Байт ключевого кадра; за его концом считаем нули
+static inline uint8_t KeyByte(const uint8_t* key, size_t keySize, size_t index) {
+    return index < keySize ? key[index] : 0;
+}
+
+static size_t EncodeDelta(const uint8_t* current, size_t size, const uint8_t* key, size_t keySize, uint8_t* out) {
+    size_t length = WriteVarint(out, static_cast<uint32_t>(size));
+    size_t i = 0;
+
+    while (i < size) {
+        size_t zeroStart = i;
+        while (i < size && current[i] == KeyByte(key, keySize, i)) i++;
+
+        // Литерал тянется до серии из 4+ совпадений - короче ее выгоднее не прерывать
+        size_t literalStart = i;
+        size_t literalEnd = i;
+        while (i < size) {
+            if (current[i] != KeyByte(key, keySize, i)) {
+                literalEnd = ++i;
+                continue;
+            }
+            size_t run = i;
+            while (run < size && run - i < 4 && current[run] == KeyByte(key, keySize, run)) run++;
+            if (run - i >= 4 || run == size) break;
+            i = run;
+        }
+        i = literalEnd;
+
+        if (literalEnd == literalStart) break; // Хвост из одних совпадений
+
+        length += WriteVarint(out + length, static_cast<uint32_t>(literalStart - zeroStart));
+        length += WriteVarint(out + length, static_cast<uint32_t>(literalEnd - literalStart));
+        for (size_t j = literalStart; j < literalEnd; j++) {
+            out[length++] = current[j] ^ KeyByte(key, keySize, j);
+        }
+    }
+    return length;
+}
+
+// Верхняя граница размера дельты для снимка из size байт
+static size_t MaxDeltaSize(size_t size) {
+    return size + size / 2 + 16;
+}
+
+RewindBuffer::RewindBuffer(size_t maxFrames, int keyframeInterval, size_t arenaBytes, size_t maxSnapshotBytes)
+    : frames(maxFrames), firstFrame(0), frameCount(0), arena(arenaBytes), writeOffset(0),
+    keyframeInterval(keyframeInterval), framesSinceKeyframe(0), currentKeyOffset(0), currentKeySize(0),
+    snapshot(maxSnapshotBytes), encoded(MaxDeltaSize(maxSnapshotBytes)) {
+    Clear();
+}
+
+void RewindBuffer::Clear() {
+    firstFrame = 0;
+    frameCount = 0;
+    writeOffset = 0;
+    framesSinceKeyframe = keyframeInterval; // Первый кадр - ключевой
+}
+
+size_t RewindBuffer::GetUsedBytes() const {
+    size_t used = 0;
+    for (size_t i = 0; i < frameCount; i++) {
+        used += frames[(firstFrame + i) % frames.size()].size;
+    }
+    return used;
+}
+
+void RewindBuffer::DropOldest() {
+    // Вместе с ключевым кадром уходят и дельты, которые от него считались
+    do {
+        firstFrame = (firstFrame + 1) % frames.size();
+        frameCount--;
+    } while (frameCount > 0 && !FrameAt(0).isKeyframe);
+}
+
+// Место под запись в кольце байт; старые кадры вытесняются, пока не влезет
+bool RewindBuffer::Reserve(size_t size, uint32_t& offset) {
+    if (size > arena.size()) return false;
+
+    while (true) {
+        if (frameCount == 0) {
+            writeOffset = 0;
+            break;
+        }
+
+        size_t tail = FrameAt(0).offset;
+        if (writeOffset > tail) {
+            // Занято [tail, writeOffset): свободен конец буфера и начало до tail
+            if (writeOffset + size <= arena.size()) break;
+            if (size <= tail) {
+                writeOffset = 0;
+                break;
+            }
+        }
+        else if (writeOffset < tail && writeOffset + size <= tail) {
+            break;
+        }
+        // writeOffset == tail при живых кадрах - буфер заполнен целиком
+        DropOldest();
+    }
+
+    offset = static_cast<uint32_t>(writeOffset);
+    return true;
+}
+
+bool RewindBuffer::Capture(const Simulation& sim) {
+    size_t snapshotSize = sim.SaveSnapshot(snapshot.data(), snapshot.size());
+    if (snapshotSize == 0) return false;
+
+    // Места под кадры нет - забываем самый старый
+    if (frameCount == frames.size()) {
+        DropOldest();
+    }
+
+    bool isKeyframe = framesSinceKeyframe >= keyframeInterval;
+    const uint8_t* record = snapshot.data();
+    size_t recordSize = snapshotSize;
+
+    if (!isKeyframe) {
+        recordSize = EncodeDelta(snapshot.data(), snapshotSize, arena.data() + currentKeyOffset, currentKeySize, encoded.data());
+        record = encoded.data();
+    }
+
+    uint32_t offset = 0;
+    if (!Reserve(recordSize, offset)) return false;
+
+    // Вытеснение могло забрать ключевой кадр этой дельты. Он самый новый из
+    // ключевых, поэтому вместе с ним ушли бы и все кадры после него
+    if (!isKeyframe && frameCount == 0) {
+        isKeyframe = true;
+        record = snapshot.data();
+        recordSize = snapshotSize;
+        if (!Reserve(recordSize, offset)) return false;
+    }
+
+    std::memcpy(arena.data() + offset, record, recordSize);
+    writeOffset = offset + recordSize;
+
+    if (isKeyframe) {
+        currentKeyOffset = offset;
+        currentKeySize = static_cast<uint32_t>(recordSize);
+        framesSinceKeyframe = 0;
+    }
+    framesSinceKeyframe++;
+
+    Frame& frame = FrameAt(frameCount);
+    frame.offset = offset;
+    frame.size = static_cast<uint32_t>(recordSize);
+    frame.keyOffset = currentKeyOffset;
+    frame.keySize = currentKeySize;
+    frame.isKeyframe = isKeyframe;
+    frameCount++;
+    return true;
+}
+
+bool RewindBuffer::Decode(const Frame& frame, size_t& snapshotSize) {
+    const uint8_t* data = arena.data() + frame.offset;
+
+    if (frame.isKeyframe) {
+        if (frame.size > snapshot.size()) return false;
+        std::memcpy(snapshot.data(), data, frame.size);
+        snapshotSize = frame.size;
+        return true;
+    }
+
+    const uint8_t* key = arena.data() + frame.keyOffset;
+    size_t position = 0;
+    snapshotSize = ReadVarint(data, frame.size, position);
+    if (snapshotSize > snapshot.size()) return false;
+
+    // Совпадающие байты берем из ключевого кадра, затем накладываем литералы
+    for (size_t i = 0; i < snapshotSize; i++) {
+        snapshot[i] = KeyByte(key, frame.keySize, i);
+    }
+
+    size_t index = 0;
+    while (position < frame.size) {
+        index += ReadVarint(data, frame.size, position);
+        size_t literal = ReadVarint(data, frame.size, position);
+        if (index + literal > snapshotSize || position + literal > frame.size) return false;
+        for (size_t j = 0; j < literal; j++) {
+            snapshot[index + j] ^= data[position + j];
+        }
+        index += literal;
+        position += literal;
+    }
+    return true;
+}
+
+bool RewindBuffer::Rewind(Simulation& sim, int steps) {
+    if (frameCount == 0 || steps <= 0) return false;
+
+    Frame frame = FrameAt(frameCount - 1);
+    for (int i = 0; i < steps && frameCount > 0; i++) {
+        frame = FrameAt(frameCount - 1);
+        frameCount--;
+    }
+
+    // Снятые кадры освобождают место; байты последнего еще целы для чтения
+    writeOffset = frame.offset;
+    if (frameCount == 0) writeOffset = 0;
+    // Ключевой кадр мог быть снят - следующий захват начнет новую группу
+    framesSinceKeyframe = keyframeInterval;
+
+    size_t snapshotSize = 0;
+    return Decode(frame, snapshotSize) && sim.LoadSnapshot(snapshot.data(), snapshotSize);
+}
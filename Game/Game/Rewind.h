@@ -0,0 +1,62 @@
+﻿#pragma once
+
+#include "Simulation.h"
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Перемотка назад: кольцевой буфер снимков последних тиков.
+// Каждый keyframeInterval-й кадр хранится целиком (ключевой), остальные -
+// как XOR с ключевым кадром, сжатый по сериям нулей: между соседними
+// тиками меняется лишь малая часть байт. Вся память выделяется в
+// конструкторе; Capture и Rewind ее не выделяют. Когда место в буфере
+// кончается, самые старые кадры вытесняются.
+
+class RewindBuffer {
+public:
+    // maxFrames - сколько тиков помнить, arenaBytes - память под кадры,
+    // maxSnapshotBytes - предел размера одного снимка
+    RewindBuffer(size_t maxFrames, int keyframeInterval, size_t arenaBytes, size_t maxSnapshotBytes);
+
+    void Clear();
+
+    // Запомнить текущее состояние (раз в тик). false - снимок не влез в лимит
+    bool Capture(const Simulation& sim);
+
+    // Вернуть sim на steps кадров назад: кадры снимаются с вершины,
+    // sim получает состояние последнего снятого. false - кадров не осталось
+    bool Rewind(Simulation& sim, int steps);
+
+    size_t GetFrameCount() const { return frameCount; }
+    size_t GetUsedBytes() const;
+
+private:
+    struct Frame {
+        uint32_t offset;    // Начало записи в arena
+        uint32_t size;      // Длина записи
+        uint32_t keyOffset; // Ключевой кадр, от которого считается дельта
+        uint32_t keySize;
+        bool isKeyframe;
+    };
+
+    std::vector<Frame> frames; // Кольцо кадров
+    size_t firstFrame;
+    size_t frameCount;
+
+    std::vector<uint8_t> arena; // Кольцо байт под записи кадров
+    size_t writeOffset;
+
+    int keyframeInterval;
+    int framesSinceKeyframe;
+    uint32_t currentKeyOffset;
+    uint32_t currentKeySize;
+
+    // Рабочие буферы: снимок и его закодированная дельта
+    std::vector<uint8_t> snapshot;
+    std::vector<uint8_t> encoded;
+
+    Frame& FrameAt(size_t index) { return frames[(firstFrame + index) % frames.size()]; }
+    bool Reserve(size_t size, uint32_t& offset);
+    void DropOldest();
+    bool Decode(const Frame& frame, size_t& snapshotSize);
+};
@@ -0,0 +1,56 @@
+﻿#pragma once
+
+#include <cstddef>
+#include <vector>
+
+// Очередь FIFO постоянной емкости поверх одного массива. Память
+// выделяется только в Reserve; PushBack и PopFront ее не трогают, поэтому
+// очередь годится для списков, которые меняются каждый тик забега.
+
+template <typename T>
+class RingBuffer {
+public:
+    RingBuffer() : head(0), count(0), mask(0) {}
+
+    // Емкость округляется вверх до степени двойки, содержимое сбрасывается
+    void Reserve(size_t capacity) {
+        size_t size = 1;
+        while (size < capacity) size <<= 1;
+        slots.assign(size, T());
+        mask = size - 1;
+        Clear();
+    }
+
+    void Clear() {
+        head = 0;
+        count = 0;
+    }
+
+    size_t GetCapacity() const { return slots.size(); }
+    size_t GetCount() const { return count; }
+    bool IsEmpty() const { return count == 0; }
+    bool IsFull() const { return count == slots.size(); }
+
+    // false - очередь полна, значение не добавлено
+    bool PushBack(const T& value) {
+        if (IsFull()) return false;
+        slots[(head + count) & mask] = value;
+        count++;
+        return true;
+    }
+
+    const T& Front() const { return slots[head]; }
+    void PopFront() {
+        head = (head + 1) & mask;
+        count--;
+    }
+
+    // i-й от головы
+    const T& operator[](size_t i) const { return slots[(head + i) & mask]; }
+
+private:
+    std::vector<T> slots;
+    size_t head;
+    size_t count;
+    size_t mask;
+};
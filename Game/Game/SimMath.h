@@ -0,0 +1,140 @@
+﻿#pragma once
+
+// Минимальная математика для ядра симуляции (без зависимости от raylib)
+
+// Тип чисел симуляции. По умолчанию float; с GAME_FIXED_POINT - Q16.16
+// (Fixed.h), и тогда повторы воспроизводятся бит в бит на любом компиляторе
+#ifdef GAME_FIXED_POINT
+#include "Fixed.h"
+
+typedef Fixed Scalar;
+typedef FixedDistance Distance; // Пройденный путь - растет весь забег
+#else
+#include <cmath>
+
+typedef float Scalar;
+typedef double Distance;
+
+inline float Sqrt(float value) { return std::sqrt(value); }
+inline float Abs(float value) { return std::fabs(value); }
+#endif
+
+// Для отрисовки и статистики
+inline float ToFloat(Scalar value) { return static_cast<float>(value); }
+
+struct Vec3 {
+    Scalar x;
+    Scalar y;
+    Scalar z;
+};
+
+inline Vec3 Subtract(Vec3 a, Vec3 b) {
+    return { a.x - b.x, a.y - b.y, a.z - b.z };
+}
+
+inline Scalar Dot(Vec3 a, Vec3 b) {
+    return a.x * b.x + a.y * b.y + a.z * b.z;
+}
+
+// Выровненный по осям параллелепипед
+struct Box {
+    Vec3 min;
+    Vec3 max;
+};
+
+inline Box OffsetBox(const Box& box, Vec3 offset) {
+    return {
+        { box.min.x + offset.x, box.min.y + offset.y, box.min.z + offset.z },
+        { box.max.x + offset.x, box.max.y + offset.y, box.max.z + offset.z }
+    };
+}
+
+// Пересечение двух боксов (та же логика, что у CheckCollisionBoxes в raylib)
+inline bool BoxesOverlap(const Box& a, const Box& b) {
+    return a.max.x >= b.min.x && a.min.x <= b.max.x &&
+        a.max.y >= b.min.y && a.min.y <= b.max.y &&
+        a.max.z >= b.min.z && a.min.z <= b.max.z;
+}
+
+// Пересечение бокса и сферы (та же логика, что у CheckCollisionBoxSphere в raylib)
+inline bool BoxSphereOverlap(const Box& box, Vec3 center, Scalar radius) {
+    Scalar dmin = 0.0f;
+
+    if (center.x < box.min.x) dmin += (center.x - box.min.x) * (center.x - box.min.x);
+    else if (center.x > box.max.x) dmin += (center.x - box.max.x) * (center.x - box.max.x);
+
+    if (center.y < box.min.y) dmin += (center.y - box.min.y) * (center.y - box.min.y);
+    else if (center.y > box.max.y) dmin += (center.y - box.max.y) * (center.y - box.max.y);
+
+    if (center.z < box.min.z) dmin += (center.z - box.min.z) * (center.z - box.min.z);
+    else if (center.z > box.max.z) dmin += (center.z - box.max.z) * (center.z - box.max.z);
+
+    return dmin <= radius * radius;
+}
+
+// Непрерывная проверка: за тик бокс a смещается на moveA, бокс b - на moveB
+// (a и b - положения в начале тика). Возвращает отрезок [enter, exit] долей
+// тика, когда боксы перекрываются. В отличие от проверки по концам тика,
+// быстрые объекты не "проскакивают" друг сквозь друга.
+inline bool SweepAxis(Scalar aMin, Scalar aMax, Scalar bMin, Scalar bMax, Scalar move, Scalar& enter, Scalar& exit) {
+    if (move == 0.0f) {
+        if (aMax < bMin || aMin > bMax) return false;
+        enter = 0.0f;
+        exit = 1.0f;
+        return true;
+    }
+    Scalar t0 = (bMin - aMax) / move;
+    Scalar t1 = (bMax - aMin) / move;
+    enter = t0 < t1 ? t0 : t1;
+    exit = t0 < t1 ? t1 : t0;
+    return true;
+}
+
+inline bool SweepBoxes(const Box& a, Vec3 moveA, const Box& b, Vec3 moveB, Scalar& enter, Scalar& exit) {
+    Vec3 move = Subtract(moveA, moveB);
+    Scalar axisEnter[3];
+    Scalar axisExit[3];
+
+    if (!SweepAxis(a.min.x, a.max.x, b.min.x, b.max.x, move.x, axisEnter[0], axisExit[0]) ||
+        !SweepAxis(a.min.y, a.max.y, b.min.y, b.max.y, move.y, axisEnter[1], axisExit[1]) ||
+        !SweepAxis(a.min.z, a.max.z, b.min.z, b.max.z, move.z, axisEnter[2], axisExit[2])) {
+        return false;
+    }
+
+    enter = 0.0f;
+    exit = 1.0f;
+    for (int i = 0; i < 3; i++) {
+        if (axisEnter[i] > enter) enter = axisEnter[i];
+        if (axisExit[i] < exit) exit = axisExit[i];
+    }
+    return enter <= exit;
+}
+
+// То же для бокса и сферы: отрезок ищется по описанному вокруг сферы
+// боксу, точная проверка - в момент наибольшего сближения внутри него
+inline bool SweepBoxSphere(const Box& box, Vec3 moveBox, Vec3 center, Vec3 moveCenter, Scalar radius, Scalar& hitTime) {
+    Box sphereBox = {
+        { center.x - radius, center.y - radius, center.z - radius },
+        { center.x + radius, center.y + radius, center.z + radius }
+    };
+    Scalar enter;
+    Scalar exit;
+    if (!SweepBoxes(box, moveBox, sphereBox, moveCenter, enter, exit)) return false;
+
+    Vec3 boxCenter = { (box.min.x + box.max.x) / 2, (box.min.y + box.max.y) / 2, (box.min.z + box.max.z) / 2 };
+    Vec3 offset = Subtract(center, boxCenter);
+    Vec3 move = Subtract(moveCenter, moveBox);
+    Scalar moveLength = Dot(move, move);
+
+    Scalar t = enter;
+    if (moveLength > 0.0f) {
+        t = -Dot(offset, move) / moveLength;
+        if (t < enter) t = enter;
+        if (t > exit) t = exit;
+    }
+
+    Box movedBox = OffsetBox(box, { moveBox.x * t, moveBox.y * t, moveBox.z * t });
+    Vec3 movedCenter = { center.x + moveCenter.x * t, center.y + moveCenter.y * t, center.z + moveCenter.z * t };
+    hitTime = t;
+    return BoxSphereOverlap(movedBox, movedCenter, radius);
+}
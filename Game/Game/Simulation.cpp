@@ -0,0 +1,974 @@
+﻿#include "Simulation.h"
+#include "AllocationGuard.h"
+#include <algorithm>
+
+// Радиус сферы монет и усилений при проверке столкновений
+static const Scalar pickupRadius = 0.5f;
+
+// Запас к окну контакта: позиции и путь копятся с разной точностью
+static const Scalar contactMargin = 0.05f;
+
+// Сколько объектов одной полосы может быть в зоне игрока сразу - с запасом
+static const size_t laneDueCapacity = 64;
+
+static bool IsDueBefore(const CollisionEvent& a, const CollisionEvent& b) {
+    if (a.kind != b.kind) return a.kind < b.kind;
+    return a.id < b.id;
+}
+
+Simulation::Simulation() : Simulation(SimConfig()) {}
+
+Simulation::Simulation(const SimConfig& config, uint64_t seed) : config(config), seed(seed) {
+    // Настройка дорожек
+    ApplyLaneCount();
+
+    // Инициализация игрока
+    player.size = { 1.0f, 2.0f, 1.0f };
+    player.speed = 5.0f;
+    player.gravity = 15.0f;
+    player.laneChangeSpeed = 15.0f;
+    player.originalSpeed = player.speed;
+
+    companion.isActive = true;
+
+    // Вся память забега - здесь и в ApplyLaneCount: спавн, уход объектов
+    // и загрузка снимков того же забега ее уже не выделяют
+    obstacles.Reserve(obstacleCapacity);
+    coins.Reserve(coinCapacity);
+    magnetCandidates.reserve(coins.GetCapacity());
+    powerUps.Reserve(powerUpCapacity);
+    attractedCoins.Reserve(0, coinCapacity);
+    dueEvents.reserve(maxLaneCount * laneDueCapacity + coinCapacity);
+    timers.Reserve(64);
+    ticksPerSecond = 0;
+
+    for (int i = 0; i < upgradeCount; i++) {
+        upgradeLevels[i] = 1;
+    }
+
+    coinsCollected = 0;
+
+    Reset();
+}
+
+void Simulation::Reset(uint64_t newSeed) {
+    seed = newSeed;
+    Reset();
+}
+
+void Simulation::Reset() {
+    SeedStreams();
+
+    // Старт в средней полосе (при четном числе - правее середины)
+    int startLane = config.laneCount / 2;
+    player.position = { lanePositions[startLane], 1.0f, 0.0f };
+    player.previousPosition = player.position;
+    player.size.y = 2.0f;
+    player.lane = startLane;
+    player.targetLane = startLane;
+    player.isJumping = false;
+    player.isRolling = false;
+    player.jumpVelocity = 0;
+    player.jump = JumpArc();
+    player.speed = player.originalSpeed;
+    player.isOnObstacle = false;
+    player.rollCooldownTimer = noTimer;
+    player.isFalling = false;
+    player.isLyingDown = false;
+    player.fallTimer = noTimer;
+    player.fallRotation = 0.0f;
+
+    // Сброс компаньона (начинает СЗАДИ игрока - положительное Z)
+    companion.followDistance = 3.0f;
+    companion.position = { lanePositions[startLane], 1.0f, player.position.z + companion.followDistance };
+    companion.previousPosition = companion.position;
+    companion.lane = startLane;
+    companion.delayTicks = 0;
+    companion.isJumping = false;
+    companion.isRolling = false;
+    companion.size = companion.originalSize; // Восстанавливаем оригинальный размер
+    companion.isFallingBehind = false; // 5 секунд бежим ВМЕСТЕ с игроком
+    companion.isCatchingUp = false;
+
+    playerTrajectory.Clear();
+    obstacles.Clear();
+    coins.Clear();
+    powerUps.Clear();
+    // Слоты пишутся в снимок целиком - и неактивные тоже
+    for (auto& slot : player.powerUps) slot = ActivePowerUp();
+    player.activePowerUps = 0;
+    UpdatePowerUpModifiers();
+    for (auto& lane : lanes) {
+        lane.collisions.Clear();
+        lane.obstacles.Clear();
+    }
+    attractedCoins.Clear();
+    timers.Clear();
+    nextEntityId = 0;
+
+    tick = 0;
+    deathCause = ObstacleType::JUMP_OVER;
+    score = 0;
+    scoreAccumulator = 0.0f;
+    gameOver = false;
+    environmentOffset = 0.0f;
+    previousEnvironmentOffset = 0.0f;
+    distance = 0.0;
+    ResetEntityScroll();
+    currentDifficulty = difficulty.Evaluate(distance);
+}
+
+void Simulation::SetUpgradeLevel(UpgradeType type, int level) {
+    upgradeLevels[static_cast<int>(type)] = level;
+    UpdatePowerUpModifiers();
+}
+
+Scalar Simulation::GetUpgradeValue(UpgradeType type) const {
+    return ::GetUpgradeValue(type, GetUpgradeLevel(type));
+}
+
+void Simulation::SeedStreams() {
+    obstacleRandom.Seed(seed, static_cast<uint64_t>(RandomStream::OBSTACLES));
+    coinRandom.Seed(seed, static_cast<uint64_t>(RandomStream::COINS));
+    powerUpRandom.Seed(seed, static_cast<uint64_t>(RandomStream::POWER_UPS));
+}
+
+void Simulation::SetLaneCount(int count) {
+    config.laneCount = count;
+    ApplyLaneCount();
+}
+
+// Полосы по числу из config: позиции по X симметрично относительно нуля
+// и данные полос. Память выделяется только здесь, не во время забега
+void Simulation::ApplyLaneCount() {
+    config.laneCount = std::min(std::max(config.laneCount, minLaneCount), maxLaneCount);
+    for (int i = 0; i < config.laneCount; i++) {
+        lanePositions[i] = Scalar(2 * i - (config.laneCount - 1)) * config.laneWidth / 2;
+    }
+
+    // В худшем случае все объекты трассы - в одной полосе
+    lanes.resize(config.laneCount);
+    for (auto& lane : lanes) {
+        lane.collisions.Clear();
+        lane.collisions.Reserve(coinCapacity + powerUpCapacity, laneDueCapacity);
+        lane.obstacles.Reserve(obstacleCapacity);
+    }
+}
+
+// Полоса, в границы которой попадает X (за краями трассы - крайняя)
+int Simulation::GetLaneAt(Scalar x) const {
+    Scalar leftEdge = lanePositions[0] - config.laneWidth / 2;
+    if (x <= leftEdge) return 0;
+    // Сравнение до приведения: NaN и бесконечность из снимка в int не переводятся
+    Scalar offset = (x - leftEdge) / config.laneWidth;
+    if (!(offset < config.laneCount)) return config.laneCount - 1;
+    return static_cast<int>(offset);
+}
+
+bool Simulation::FindObstacle(uint32_t id, Obstacle& obstacle) const {
+    size_t index = obstacles.Find(id);
+    if (index == EntityColumns::npos) return false;
+    obstacle = obstacles.Get(index);
+    return true;
+}
+
+void Simulation::SetCrowdSize(int count) {
+    crowd.Resize(count);
+}
+
+void Simulation::Step(Scalar dt, const InputState& input) {
+    // Первый тик забега узнает частоту тиков и под нее заводит таймеры и
+    // историю игрока; дальше тик работает только с готовой памятью
+    NoAllocationScope noAllocations(tick > 0);
+
+    SavePreviousState();
+    tick++;
+
+    // Частота тиков целая (как в Replay) - по ней секунды переводятся в тики
+    ticksPerSecond = static_cast<int>(1 / dt + 0.5f);
+    if (tick == 1) {
+        StartRunTimers();
+        ReserveTrajectory();
+    }
+
+    if (gameOver) {
+        // Обрабатываем падение персонажа
+        FireTimers();
+        if (player.isFalling) {
+            UpdatePlayerFall(dt);
+        }
+        return;
+    }
+
+    // Сложность считается один раз за тик - дальше все читают currentDifficulty.
+    // Окно приземления переводит путь во время по скорости мира, поэтому
+    // разгон в полете требует нового прогноза
+    Scalar previousSpeed = currentDifficulty.speed;
+    currentDifficulty = difficulty.Evaluate(distance);
+    if (player.isJumping && currentDifficulty.speed != previousSpeed) {
+        InvalidateLandingPredictions();
+    }
+
+    FireTimers();
+    HandleInput(input);
+    UpdatePlayer(dt);
+
+    // Мир сдвигается одним числом: позиции объектов выводятся из пути
+    Distance scroll = distance + currentDifficulty.speed * dt;
+    UpdateObstacles(scroll);
+    UpdateCoins(dt, scroll);
+    UpdatePowerUps(scroll);
+    CheckCollisions(dt);
+    RecordTrajectory();
+    UpdateCompanion();
+    UpdateCrowd();
+
+    distance += currentDifficulty.speed * dt;
+
+    environmentOffset += currentDifficulty.speed * 0.3f * dt;
+    if (environmentOffset > 50.0f) environmentOffset = 0.0f;
+
+    scoreAccumulator += config.scorePerSecond * dt * modifiers.scoreMultiplier;
+    int wholePoints = static_cast<int>(scoreAccumulator);
+    score += wholePoints;
+    scoreAccumulator -= wholePoints;
+}
+
+// Секунды в тики с округлением вверх: эффект длится не меньше заказанного.
+// Сотая доля тика - погрешность представления секунд, а не лишний тик
+uint32_t Simulation::ToTicks(Scalar seconds) const {
+    Scalar ticks = seconds * ticksPerSecond - 0.01f;
+    int whole = static_cast<int>(ticks);
+    if (ticks > whole) whole++;
+    return whole > 1 ? static_cast<uint32_t>(whole) : 1;
+}
+
+Scalar Simulation::GetTimeLeft(TimerHandle timer) const {
+    if (ticksPerSecond <= 0) return 0.0f;
+    return Scalar(static_cast<int>(timers.GetTicksLeft(timer))) / ticksPerSecond;
+}
+
+// Длина тика известна только в первом Step - тогда и заводятся таймеры забега
+void Simulation::StartRunTimers() {
+    timers.Schedule(TimerEvent::OBSTACLE_SPAWN, 0, ToTicks(currentDifficulty.obstacleSpawnInterval));
+    timers.Schedule(TimerEvent::COIN_SPAWN, 0, ToTicks(currentDifficulty.coinSpawnInterval));
+    timers.Schedule(TimerEvent::POWER_UP_SPAWN, 0, ToTicks(currentDifficulty.powerUpSpawnInterval));
+    timers.Schedule(TimerEvent::COMPANION_FALL_BEHIND, 0, ToTicks(5.0f));
+}
+
+void Simulation::FireTimers() {
+    for (const auto& timer : timers.Advance()) {
+        // После game over мир стоит - идет только анимация падения
+        if (gameOver && timer.event != TimerEvent::FALL_LIE_DOWN && timer.event != TimerEvent::FALL_END) {
+            continue;
+        }
+        OnTimer(timer);
+    }
+}
+
+void Simulation::OnTimer(const TimerFired& timer) {
+    switch (timer.event) {
+    case TimerEvent::NONE:
+        break;
+    case TimerEvent::ROLL_END:
+        player.isRolling = false;
+        player.size.y = 2.0f; // Возвращаем нормальную высоту
+        if (!player.isJumping && !player.isOnObstacle) {
+            player.position.y = 1.0f;
+        }
+        break;
+    case TimerEvent::FALL_LIE_DOWN:
+        player.isLyingDown = true;
+        player.position.y = 0.1f; // Лежит на земле
+        player.fallRotation = 90.0f; // Лежит на боку
+        break;
+    case TimerEvent::FALL_END:
+        // После 5 секунд показываем меню
+        player.isFalling = false;
+        break;
+    case TimerEvent::COMPANION_FALL_BEHIND:
+        companion.isFallingBehind = true;
+        break;
+    case TimerEvent::POWER_UP_END:
+        EndPowerUp(static_cast<PowerUpType>(timer.payload));
+        break;
+    case TimerEvent::OBSTACLE_SPAWN:
+        if (obstacleRandom.Int(0, 100) < 40) {
+            SpawnObstacleGroup();
+        }
+        else {
+            SpawnSingleObstacle();
+        }
+        timers.Schedule(TimerEvent::OBSTACLE_SPAWN, 0, ToTicks(currentDifficulty.obstacleSpawnInterval));
+        break;
+    case TimerEvent::COIN_SPAWN:
+        SpawnCoin();
+        timers.Schedule(TimerEvent::COIN_SPAWN, 0, ToTicks(currentDifficulty.coinSpawnInterval));
+        break;
+    case TimerEvent::POWER_UP_SPAWN:
+        SpawnPowerUp();
+        timers.Schedule(TimerEvent::POWER_UP_SPAWN, 0, ToTicks(currentDifficulty.powerUpSpawnInterval));
+        break;
+    }
+}
+
+// Общий путь мира для позиций объектов, без сдвига за тик
+void Simulation::ResetEntityScroll() {
+    obstacles.ResetScroll(distance);
+    coins.ResetScroll(distance);
+    powerUps.ResetScroll(distance);
+}
+
+// Запоминаем состояние перед тиком, чтобы отрисовка могла интерполировать
+void Simulation::SavePreviousState() {
+    player.previousPosition = player.position;
+    companion.previousPosition = companion.position;
+    crowd.SavePreviousState();
+    obstacles.SavePreviousState();
+    coins.SavePreviousState();
+    powerUps.SavePreviousState();
+    previousEnvironmentOffset = environmentOffset;
+}
+
+// Истории должно хватать на самого отстающего - компаньона, отставшего
+// на 8, или последний ряд толпы - при самой низкой скорости на кривой
+// сложности. Тогда за забег емкость больше не растет
+void Simulation::ReserveTrajectory() {
+    Scalar maxDistance = std::max(Scalar(8.0f), crowd.GetMaxDistance());
+    playerTrajectory.Reserve(ToTicks(maxDistance / difficulty.GetMinSpeed()) + 1);
+}
+
+// Итоговое состояние игрока за тик - в историю для компаньона
+void Simulation::RecordTrajectory() {
+    TrajectorySample sample;
+    sample.x = player.position.x;
+    sample.y = player.position.y;
+    sample.lane = static_cast<uint8_t>(player.lane);
+    sample.isJumping = player.isJumping;
+    sample.isRolling = player.isRolling;
+    playerTrajectory.Record(sample);
+}
+
+// Обновление компаньона: состояние игрока из истории с задержкой, равной
+// времени, за которое мир проезжает дистанцию следования. Компаньон
+// оказывается там, где игрок был, и прыгает и катится там же, где он
+void Simulation::UpdateCompanion() {
+    if (!companion.isActive) return;
+
+    // Первые 5 секунд бежим ВМЕСТЕ с игроком, потом ОТСТАЕМ
+    companion.followDistance = companion.isFallingBehind ? 8.0f : 3.0f;
+    companion.delayTicks = ToTicks(companion.followDistance / currentDifficulty.speed);
+
+    const TrajectorySample& sample = playerTrajectory.Sample(companion.delayTicks);
+    companion.position = { sample.x, sample.y, player.position.z + companion.followDistance };
+    companion.lane = sample.lane;
+    companion.isJumping = sample.isJumping;
+    companion.isRolling = sample.isRolling;
+
+    companion.size = companion.originalSize;
+    if (companion.isRolling) {
+        companion.size.y = 1.0f; // Уменьшаем высоту для переката
+        companion.size.z = 1.2f; // Увеличиваем длину для переката
+    }
+}
+
+// Задержка каждого последователя - время, за которое мир проезжает его
+// отставание, поэтому толпа бежит по пути игрока при любой скорости
+void Simulation::UpdateCrowd() {
+    if (crowd.GetSize() == 0) return;
+
+    Scalar ticksPerUnit = Scalar(ticksPerSecond) / currentDifficulty.speed;
+    Scalar edge = lanePositions[config.laneCount - 1] + config.laneWidth / 2 - crowdFollowerSize.x / 2;
+    crowd.Update(playerTrajectory, player.position.z, ticksPerUnit, -edge, edge);
+}
+
+void Simulation::StartJump(JumpArc& arc, Scalar startHeight, Scalar velocity, Scalar gravity) {
+    arc.startHeight = startHeight;
+    arc.startVelocity = velocity;
+    arc.gravity = gravity;
+    arc.time = 0.0f;
+    arc.needsPrediction = true;
+}
+
+// Приземление: на землю или на препятствие, передняя грань которого
+// проходит под передней гранью прыгающего, когда тот уже опустился до его
+// верха. Препятствия движутся равномерно, поэтому окно перекрытия по Z
+// считается сразу, без покадровой проверки
+void Simulation::PredictLanding(JumpArc& arc, int lane, Scalar frontZ) const {
+    const Scalar groundHeight = 1.0f;
+    const Scalar faceHalfDepth = 0.1f;
+    Scalar speed = currentDifficulty.speed;
+
+    arc.landingTime = JumpDescentTime(arc, groundHeight);
+    arc.landingHeight = groundHeight;
+    arc.landsOnObstacle = false;
+    arc.needsPrediction = false;
+
+    // Очередь - по порядку подхода: как только препятствие подходит позже
+    // уже найденного приземления, дальние подходят еще позже
+    const RingBuffer<LaneObstacle>& laneObstacles = lanes[lane].obstacles;
+    for (size_t i = 0; i < laneObstacles.GetCount(); i++) {
+        size_t index = obstacles.Find(laneObstacles[i].id);
+        if (index == EntityColumns::npos) continue;
+        Vec3 position = obstacles.GetPosition(index);
+        const ObstacleArchetype& archetype = obstacles.GetArchetype(index);
+        Vec3 size = archetype.size;
+
+        // Когда передние грани перекрываются по Z (толщина каждой - 0.2)
+        Scalar gap = frontZ - (position.z + size.z / 2);
+        Scalar enterTime = arc.time + (gap - 2.0f * faceHalfDepth) / speed;
+        Scalar exitTime = arc.time + (gap + 2.0f * faceHalfDepth) / speed;
+        if (enterTime >= arc.landingTime) break;
+
+        if (!archetype.canLandOn) continue;
+        Scalar obstacleTop = position.y + size.y / 2;
+        if (obstacleTop <= groundHeight) continue;
+
+        Scalar topTime = JumpDescentTime(arc, obstacleTop);
+        if (topTime < 0.0f) continue; // Не допрыгнуть
+
+        Scalar landingTime = std::max(std::max(topTime, enterTime), arc.time);
+        if (landingTime <= exitTime && landingTime < arc.landingTime) {
+            arc.landingTime = landingTime;
+            arc.landingHeight = obstacleTop;
+            arc.landsOnObstacle = true;
+        }
+    }
+}
+
+// Новое препятствие может оказаться под прыгающим игроком
+void Simulation::InvalidateLandingPredictions() {
+    player.jump.needsPrediction = true;
+}
+
+// Обновление анимации падения (фазы переключают таймеры FALL_LIE_DOWN и FALL_END)
+void Simulation::UpdatePlayerFall(Scalar dt) {
+    // Анимация падения: персонаж падает и вращается
+    if (!player.isLyingDown) {
+        player.position.y -= 8.0f * dt;
+        player.fallRotation += 180.0f * dt; // Вращение при падении
+    }
+}
+
+void Simulation::HandleInput(const InputState& input) {
+    // Движение влево-вправо с плавным перемещением
+    if (input.left && player.targetLane > 0) {
+        player.targetLane--;
+    }
+    if (input.right && player.targetLane < config.laneCount - 1) {
+        player.targetLane++;
+    }
+
+    // Прыжок
+    if (input.jump && !player.isJumping && !player.isRolling) {
+        player.isJumping = true;
+        player.jumpVelocity = 8.0f;
+        player.isOnObstacle = false; // Сбрасываем статус нахождения на препятствии при прыжке
+        StartJump(player.jump, player.position.y, player.jumpVelocity, player.gravity);
+    }
+
+    // ПЕРЕКАТ вместо приседания - мгновенное действие с кулдауном
+    if (input.roll && !player.isJumping && !player.isRolling && !timers.IsActive(player.rollCooldownTimer)) {
+        player.isRolling = true;
+        player.size.y = 1.0f; // Уменьшаем высоту для переката
+        player.position.y = 0.5f;
+        timers.Schedule(TimerEvent::ROLL_END, 0, ToTicks(1.0f)); // ПЕРЕКАТ ДЛИТСЯ 1 СЕКУНДУ
+        player.rollCooldownTimer = timers.Schedule(TimerEvent::NONE, 0, ToTicks(1.5f)); // КУЛДАУН 1.5 СЕКУНДЫ
+    }
+}
+
+void Simulation::UpdatePlayer(Scalar dt) {
+    int previousLane = player.lane;
+
+    // Плавное перемещение между полосами
+    Scalar targetX = lanePositions[player.targetLane];
+    if (Abs(player.position.x - targetX) > 0.01f) {
+        Scalar direction = (targetX > player.position.x) ? 1.0f : -1.0f;
+        player.position.x += direction * player.laneChangeSpeed * dt;
+
+        // Ограничиваем позицию, чтобы не перескакивать целевую позицию
+        if ((direction > 0 && player.position.x > targetX) ||
+            (direction < 0 && player.position.x < targetX)) {
+            player.position.x = targetX;
+            player.lane = player.targetLane; // Обновляем текущую полосу когда достигаем цели
+        }
+    }
+    else {
+        player.lane = player.targetLane; // Обновляем текущую полосу
+    }
+
+    // Сменили полосу в воздухе - под нами другие препятствия
+    if (player.isJumping && player.lane != previousLane) {
+        player.jump.needsPrediction = true;
+    }
+
+    // Обновление прыжка: высота по времени с отрыва, приземление предсказано заранее
+    if (player.isJumping) {
+        if (player.jump.needsPrediction) {
+            PredictLanding(player.jump, player.lane, player.position.z + player.size.z / 2);
+        }
+
+        player.jump.time += dt;
+        if (player.jump.time >= player.jump.landingTime) {
+            player.position.y = player.jump.landingHeight;
+            player.isJumping = false;
+            player.jumpVelocity = 0;
+            player.isOnObstacle = player.jump.landsOnObstacle;
+        }
+        else {
+            player.position.y = JumpHeightAt(player.jump, player.jump.time);
+            player.jumpVelocity = JumpVelocityAt(player.jump, player.jump.time);
+        }
+    }
+}
+
+Box Simulation::GetPlayerFrontFaceBox() const {
+    // Bounding box только для передней грани игрока
+    Scalar frontOffset = player.size.z / 2;
+    return {
+        { player.position.x - player.size.x / 2, player.position.y - player.size.y / 2, player.position.z + frontOffset - 0.1f },
+        { player.position.x + player.size.x / 2, player.position.y + player.size.y / 2, player.position.z + frontOffset + 0.1f }
+    };
+}
+
+Box Simulation::GetObstacleFrontFaceBox(const Obstacle& obstacle) const {
+    // Bounding box только для передней грани препятствия
+    Vec3 size = GetArchetype(obstacle.type).size;
+    Scalar frontOffset = size.z / 2;
+    return {
+        { obstacle.position.x - size.x / 2, obstacle.position.y - size.y / 2, obstacle.position.z + frontOffset - 0.1f },
+        { obstacle.position.x + size.x / 2, obstacle.position.y + size.y / 2, obstacle.position.z + frontOffset + 0.1f }
+    };
+}
+
+// Спавн - по таймеру OBSTACLE_SPAWN (OnTimer)
+void Simulation::UpdateObstacles(Distance scroll) {
+    // Прошедшие игрока (distance - путь на начало тика) снимаются с головы
+    // очередей полос - по одному сравнению на полосу, без поиска в хранилище
+    for (auto& lane : lanes) {
+        RingBuffer<LaneObstacle>& laneObstacles = lane.obstacles;
+        while (!laneObstacles.IsEmpty() && laneObstacles.Front().exitDistance < distance) {
+            laneObstacles.PopFront();
+        }
+    }
+
+    // Сдвиг всех препятствий - новый путь мира; ушедшие за игрока - с головы
+    obstacles.Scroll(scroll);
+    obstacles.Despawn(config.despawnDistance);
+}
+
+void Simulation::SpawnSingleObstacle() {
+    int lane = obstacleRandom.Int(0, config.laneCount - 1);
+    ObstacleType type = static_cast<ObstacleType>(obstacleRandom.Int(0, obstacleTypeCount - 1));
+    AddObstacle(lane, type);
+}
+
+// Ряд препятствий во всю ширину трассы. Проходимость: среди любых трех
+// соседних полос есть не-WALL, то есть из любой полосы до прохода не
+// больше двух перестроений - как на исходной трассе из трех полос
+void Simulation::SpawnObstacleGroup() {
+    const int laneCount = config.laneCount;
+    bool hasPassableLane = false;
+    ObstacleType laneTypes[maxLaneCount];
+
+    do {
+        for (int lane = 0; lane < laneCount; lane++) {
+            laneTypes[lane] = static_cast<ObstacleType>(obstacleRandom.Int(0, obstacleTypeCount - 1));
+        }
+
+        hasPassableLane = true;
+        int wallRun = 0;
+        for (int lane = 0; lane < laneCount; lane++) {
+            wallRun = laneTypes[lane] == ObstacleType::WALL ? wallRun + 1 : 0;
+            if (wallRun >= 3) {
+                hasPassableLane = false;
+                break;
+            }
+        }
+    } while (!hasPassableLane);
+
+    for (int lane = 0; lane < laneCount; lane++) {
+        AddObstacle(lane, laneTypes[lane]);
+    }
+}
+
+// Размер и правила - из таблицы по типу, препятствие стоит на земле
+void Simulation::AddObstacle(int lane, ObstacleType type) {
+    const ObstacleArchetype& archetype = GetArchetype(type);
+    Vec3 position = { lanePositions[lane], archetype.size.y / 2, config.spawnDistance };
+    uint32_t id = nextEntityId++;
+
+    if (obstacles.Add(id, position, lane, type) == EntityColumns::npos) {
+        return;
+    }
+    QueueObstacle(lane, id, position.z, archetype.size.z / 2);
+    if (archetype.canLandOn) {
+        InvalidateLandingPredictions();
+    }
+}
+
+// Монеты движутся с той же скоростью, что и препятствия - без магнита
+// это только новый путь мира. Магнит двигает монеты по одной: позиции
+// читаются на прежнем пути, притянутые переносятся на новый. Дальше
+// радиуса по Z магнит не достает, поэтому перебираются только монеты из
+// корзин у игрока (остальные уходят за трассу с головы кольца в Despawn)
+void Simulation::UpdateCoins(Scalar dt, Distance scroll) {
+    Scalar speed = currentDifficulty.speed;
+    Scalar magnetRange = modifiers.magnetRange;
+
+    if (magnetRange > 0.0f) {
+        coins.FindInRange(player.position.z - magnetRange, player.position.z + magnetRange, magnetCandidates);
+    }
+    else {
+        magnetCandidates.clear();
+    }
+
+    for (size_t i : magnetCandidates) {
+        Vec3 position = coins.GetPosition(i);
+
+        // Эффект магнита: монеты притягиваются к игроку
+        Scalar dx = player.position.x - position.x;
+        Scalar dz = player.position.z - position.z;
+        Scalar distance = Sqrt(dx * dx + dz * dz);
+
+        if (distance < magnetRange && distance > 0.5f) {
+            // СИЛА ПРИТЯЖЕНИЯ ЗАВИСИТ ОТ СКОРОСТИ И РАССТОЯНИЯ
+            Scalar pullStrength = 20.0f + (speed * 0.8f);
+
+            // ПЛАВНОЕ ПРИТЯЖЕНИЕ
+            Scalar attraction = pullStrength * dt * (1.0f - distance / magnetRange);
+            position.x += (dx / distance) * attraction;
+
+            // ОСНОВНОЕ ДВИЖЕНИЕ ВПЕРЕД + ДОПОЛНИТЕЛЬНОЕ УСКОРЕНИЕ К ИГРОКУ
+            position.z += speed * dt;
+            position.z += (dz / distance) * attraction * 2.0f; // Более сильное притяжение по Z
+
+            // ДОПОЛНИТЕЛЬНОЕ УСКОРЕНИЕ ПРИ БЛИЗКОМ РАССТОЯНИИ
+            if (distance < 2.0f) {
+                position.z += speed * 0.5f * dt;
+            }
+
+            // Монета ушла с общей скорости и, возможно, из своей
+            // полосы - предсказание по спавну больше не верно,
+            // проверяем ее каждый тик, пока не пролетит
+            Distance enter;
+            Distance exit;
+            GetContactWindow(position.z, -pickupRadius, pickupRadius, scroll, enter, exit);
+            attractedCoins.MakeDue(CollisionKind::COIN, coins.GetId(i), exit);
+            coins.MoveTo(i, position.x, position.z, scroll);
+        }
+        else {
+            // ОБЫЧНОЕ ДВИЖЕНИЕ ЕСЛИ МОНЕТА ВНЕ ДИАПАЗОНА МАГНИТА
+            position.z += speed * dt;
+        }
+
+        // Притянутая монета могла обогнать более старые - снимаем ее сразу,
+        // не дожидаясь головы кольца
+        if (position.z > config.despawnDistance) {
+            coins.Deactivate(i);
+        }
+    }
+
+    coins.Scroll(scroll);
+    coins.Despawn(config.despawnDistance);
+}
+
+void Simulation::SpawnCoin() {
+    int lane = coinRandom.Int(0, config.laneCount - 1);
+    Vec3 position = { lanePositions[lane], 1.5f, config.spawnDistance };
+    uint32_t id = nextEntityId++;
+
+    if (coins.Add(id, position) == EntityColumns::npos) return;
+    ScheduleCollision(lane, CollisionKind::COIN, id, position.z, -pickupRadius, pickupRadius, distance);
+}
+
+void Simulation::UpdatePowerUps(Distance scroll) {
+    // Усиления также движутся со скоростью мира (вращение выводится из пути)
+    powerUps.Scroll(scroll);
+    powerUps.Despawn(config.despawnDistance);
+}
+
+void Simulation::SpawnPowerUp() {
+    PowerUp powerUp;
+    int lane = powerUpRandom.Int(0, config.laneCount - 1);
+    powerUp.position = { lanePositions[lane], 1.5f, config.spawnDistance };
+
+    int powerUpType = powerUpRandom.Int(0, 3);
+    switch (powerUpType) {
+    case 0:
+        powerUp.type = PowerUpType::SPEED_BOOST;
+        break;
+    case 1:
+        powerUp.type = PowerUpType::INVINCIBILITY;
+        break;
+    case 2:
+        powerUp.type = PowerUpType::MAGNET;
+        break;
+    case 3:
+        powerUp.type = PowerUpType::DOUBLE_POINTS;
+        break;
+    }
+
+    powerUp.id = nextEntityId++;
+    if (powerUps.Add(powerUp.id, powerUp.position, powerUp.type) == EntityColumns::npos) return;
+    ScheduleCollision(lane, CollisionKind::POWER_UP, powerUp.id, powerUp.position.z, -pickupRadius, pickupRadius, distance);
+}
+
+void Simulation::ApplyPowerUp(PowerUpType type) {
+    const PowerUpInfo& info = powerUpInfos[static_cast<int>(type)];
+    Scalar totalDuration = info.baseDuration + GetUpgradeValue(info.upgrade);
+    uint32_t durationTicks = ToTicks(totalDuration);
+
+    // Повторный подбор продлевает эффект до полной длительности
+    ActivePowerUp& slot = player.powerUps[static_cast<int>(type)];
+    if (HasPowerUp(type)) {
+        timers.Reschedule(slot.timer, durationTicks);
+    }
+    else {
+        slot.timer = timers.Schedule(TimerEvent::POWER_UP_END, static_cast<uint32_t>(type), durationTicks);
+        player.activePowerUps |= PowerUpBit(type);
+    }
+    slot.duration = totalDuration;
+
+    UpdatePowerUpModifiers();
+}
+
+// Эффект кончился (таймер POWER_UP_END)
+void Simulation::EndPowerUp(PowerUpType type) {
+    player.powerUps[static_cast<int>(type)] = ActivePowerUp();
+    player.activePowerUps &= ~PowerUpBit(type);
+    UpdatePowerUpModifiers();
+}
+
+// Сворачиваем активные эффекты в один набор множителей
+void Simulation::UpdatePowerUpModifiers() {
+    modifiers.speedMultiplier = 1.0f;
+    modifiers.scoreMultiplier = 1;
+    modifiers.magnetRange = 0.0f;
+    modifiers.invincible = false;
+
+    for (int i = 0; i < powerUpTypeCount; i++) {
+        if (!(player.activePowerUps & (1u << i))) continue;
+
+        const PowerUpInfo& info = powerUpInfos[i];
+        modifiers.speedMultiplier = modifiers.speedMultiplier * info.speedMultiplier;
+        modifiers.scoreMultiplier *= info.scoreMultiplier;
+        modifiers.invincible = modifiers.invincible || info.invincible;
+        if (info.magnet) {
+            modifiers.magnetRange = 5.0f + (GetUpgradeLevel(UpgradeType::MAGNET) * 0.5f);
+        }
+    }
+
+    player.speed = player.originalSpeed * modifiers.speedMultiplier;
+}
+
+// Отрезок пути, на котором объект с габаритом [z + zLow, z + zHigh] по Z
+// задевает переднюю грань игрока. scroll - путь, при котором объект стоит в z
+void Simulation::GetContactWindow(Scalar z, Scalar zLow, Scalar zHigh, Distance scroll, Distance& enter, Distance& exit) const {
+    Scalar playerFront = player.position.z + player.size.z / 2;
+    enter = scroll + (playerFront - 0.1f - (z + zHigh)) - contactMargin;
+    exit = scroll + (playerFront + 0.1f - (z + zLow)) + contactMargin;
+}
+
+void Simulation::ScheduleCollision(int lane, CollisionKind kind, uint32_t id, Scalar z, Scalar zLow, Scalar zHigh, Distance scroll) {
+    Distance enter;
+    Distance exit;
+    GetContactWindow(z, zLow, zHigh, scroll, enter, exit);
+    lanes[lane].collisions.Schedule(kind, id, enter, exit);
+}
+
+// Передняя грань препятствия (толщина 0.2) против передней грани игрока
+void Simulation::QueueObstacle(int lane, uint32_t id, Scalar z, Scalar halfDepth) {
+    LaneObstacle entry;
+    entry.id = id;
+    GetContactWindow(z, halfDepth - 0.1f, halfDepth + 0.1f, distance, entry.enterDistance, entry.exitDistance);
+    lanes[lane].obstacles.PushBack(entry);
+}
+
+// После загрузки снимка позиции объектов соответствуют пройденному пути.
+// Монеты раскладываются по X: магнит мог увести их из полосы спавна
+void Simulation::RebuildLanes() {
+    for (auto& lane : lanes) {
+        lane.collisions.Clear();
+        lane.obstacles.Clear();
+    }
+    attractedCoins.Clear();
+
+    for (size_t i = 0; i < obstacles.GetCount(); i++) {
+        if (obstacles.IsActive(i)) {
+            QueueObstacle(obstacles.GetLane(i), obstacles.GetId(i), obstacles.GetPosition(i).z, obstacles.GetArchetype(i).size.z / 2);
+        }
+    }
+    for (size_t i = 0; i < coins.GetCount(); i++) {
+        if (coins.IsActive(i)) {
+            Vec3 position = coins.GetPosition(i);
+            ScheduleCollision(GetLaneAt(position.x), CollisionKind::COIN, coins.GetId(i),
+                position.z, -pickupRadius, pickupRadius, distance);
+        }
+    }
+    for (size_t i = 0; i < powerUps.GetCount(); i++) {
+        if (powerUps.IsActive(i)) {
+            Vec3 position = powerUps.GetPosition(i);
+            ScheduleCollision(GetLaneAt(position.x), CollisionKind::POWER_UP, powerUps.GetId(i),
+                position.z, -pickupRadius, pickupRadius, distance);
+        }
+    }
+}
+
+// Номера полос и типы из снимка - индексы массивов и таблиц, им нельзя доверять
+static bool IsObstacleTypeValid(ObstacleType type) {
+    return static_cast<unsigned>(type) < static_cast<unsigned>(obstacleTypeCount);
+}
+
+static bool IsPowerUpTypeValid(PowerUpType type) {
+    return static_cast<unsigned>(type) < static_cast<unsigned>(powerUpTypeCount);
+}
+
+bool Simulation::IsStateValid() const {
+    if (config.laneCount < minLaneCount || config.laneCount > maxLaneCount) return false;
+    if (!(config.laneWidth > 0.0f)) return false;
+    if (player.lane < 0 || player.lane >= config.laneCount) return false;
+    if (player.targetLane < 0 || player.targetLane >= config.laneCount) return false;
+    for (size_t i = 0; i < obstacles.GetCount(); i++) {
+        if (obstacles.GetLane(i) >= config.laneCount) return false;
+        if (!IsObstacleTypeValid(obstacles.GetType(i))) return false;
+    }
+    for (size_t i = 0; i < powerUps.GetCount(); i++) {
+        if (!IsPowerUpTypeValid(powerUps.GetType(i))) return false;
+    }
+    return IsObstacleTypeValid(deathCause);
+}
+
+void Simulation::CheckCollisions(Scalar dt) {
+    // Используем bounding box только для передней грани игрока.
+    // Проверки непрерывные: боксы берутся на начало тика и сдвигаются на
+    // пройденный за тик путь, так что на высокой скорости или при редких
+    // тиках тонкие грани не проскакивают друг сквозь друга
+    Vec3 playerMove = Subtract(player.position, player.previousPosition);
+    Box playerFrontBox = OffsetBox(GetPlayerFrontFaceBox(), { -playerMove.x, -playerMove.y, -playerMove.z });
+
+    // Проверяем только объекты, которые за этот тик доходят до игрока
+    // (distance еще не сдвинут - это путь на начало тика), и только в
+    // полосах, которые задевает игрок: своя полоса и те, куда он
+    // перестраивается, с запасом на радиус подбираемых предметов
+    Distance from = distance;
+    Distance to = distance + currentDifficulty.speed * dt;
+    Scalar reach = player.size.x / 2 + pickupRadius;
+    int firstLane = std::min(player.lane, GetLaneAt(std::min(player.position.x, player.previousPosition.x) - reach));
+    int lastLane = std::max(player.lane, GetLaneAt(std::max(player.position.x, player.previousPosition.x) + reach));
+
+    dueEvents.clear();
+    for (int lane = firstLane; lane <= lastLane; lane++) {
+        const std::vector<CollisionEvent>& laneEvents = lanes[lane].collisions.Advance(from, to);
+        dueEvents.insert(dueEvents.end(), laneEvents.begin(), laneEvents.end());
+    }
+    const std::vector<CollisionEvent>& attracted = attractedCoins.Advance(from, to);
+    dueEvents.insert(dueEvents.end(), attracted.begin(), attracted.end());
+
+    // Порядок (вид, id) - как у одной общей очереди; монета может быть и
+    // в своей полосе, и среди притянутых
+    std::sort(dueEvents.begin(), dueEvents.end(), IsDueBefore);
+    dueEvents.erase(std::unique(dueEvents.begin(), dueEvents.end(),
+        [](const CollisionEvent& a, const CollisionEvent& b) { return a.kind == b.kind && a.id == b.id; }), dueEvents.end());
+
+    // Далекие полосы по одной за тик сбрасывают прошедшие объекты, чтобы
+    // их очереди не росли, пока игрок бежит в другом месте трассы
+    int idleLane = static_cast<int>(tick % static_cast<uint32_t>(config.laneCount));
+    if (idleLane < firstLane || idleLane > lastLane) {
+        lanes[idleLane].collisions.Advance(from, to);
+    }
+
+    // Сбрасываем статус нахождения на препятствии
+    bool wasOnObstacle = player.isOnObstacle;
+    player.isOnObstacle = false;
+
+    // Препятствия - только из головы очередей тех же полос, что и предметы:
+    // при двойном перестроении игрок проезжает и среднюю полосу. В очереди
+    // нет прошедших, а за первым, которое не успевает дойти за этот тик,
+    // дальние не дойдут тем более
+    for (int lane = firstLane; lane <= lastLane; lane++) {
+        const RingBuffer<LaneObstacle>& laneObstacles = lanes[lane].obstacles;
+        for (size_t i = 0; i < laneObstacles.GetCount() && laneObstacles[i].enterDistance <= to; i++) {
+            if (laneObstacles[i].exitDistance < from) continue;
+            size_t index = obstacles.Find(laneObstacles[i].id);
+            if (index == EntityColumns::npos) continue;
+            Obstacle obstacle = obstacles.Get(index);
+
+            // Используем bounding box только для передней грани препятствия
+            Vec3 obstacleMove = Subtract(obstacle.position, obstacle.previousPosition);
+            Box obstacleFrontBox = OffsetBox(GetObstacleFrontFaceBox(obstacle), { -obstacleMove.x, -obstacleMove.y, -obstacleMove.z });
+
+            Scalar enter;
+            Scalar exit;
+            if (SweepBoxes(playerFrontBox, playerMove, obstacleFrontBox, obstacleMove, enter, exit)) {
+                if (modifiers.invincible) {
+                    continue;
+                }
+
+                // Проверяем, находимся ли мы СВЕРХУ препятствия (в момент касания)
+                const ObstacleArchetype& archetype = GetArchetype(obstacle.type);
+                Scalar playerBottom = player.previousPosition.y + playerMove.y * enter - player.size.y / 2;
+                Scalar obstacleTop = obstacle.position.y + archetype.size.y / 2;
+
+                if (playerBottom >= obstacleTop - 0.1f && archetype.canLandOn) {
+                    // Игрок стоит сверху на препятствии
+                    player.isOnObstacle = true;
+                    continue; // Не считаем это столкновением
+                }
+
+                // Прыжок и перекат одновременно не спасают ни от чего
+                bool canAvoid = ((archetype.avoid & AVOID_JUMP) && player.isJumping && !player.isRolling) ||
+                    ((archetype.avoid & AVOID_ROLL) && player.isRolling && !player.isJumping);
+
+                if (!canAvoid) {
+                    // Вместо мгновенного gameOver запускаем анимацию падения
+                    player.isFalling = true;
+                    player.isLyingDown = false;
+                    player.fallRotation = 0.0f;
+                    timers.Schedule(TimerEvent::FALL_LIE_DOWN, 0, ToTicks(0.5f));
+                    player.fallTimer = timers.Schedule(TimerEvent::FALL_END, 0, ToTicks(5.0f));
+                    gameOver = true;
+                    deathCause = obstacle.type;
+                    return;
+                }
+            }
+        }
+    }
+
+    // Если был на препятствии, но больше нет - сбрасываем высоту
+    if (wasOnObstacle && !player.isOnObstacle && !player.isJumping) {
+        player.position.y = 1.0f;
+    }
+
+    for (const auto& event : dueEvents) {
+        if (event.kind != CollisionKind::COIN) continue;
+        size_t coin = coins.Find(event.id);
+        if (coin != EntityColumns::npos) {
+            // Для монет используем проверку сферы
+            Vec3 previousPosition = coins.GetPreviousPosition(coin);
+            Scalar hitTime;
+            if (SweepBoxSphere(playerFrontBox, playerMove, previousPosition,
+                Subtract(coins.GetPosition(coin), previousPosition), pickupRadius, hitTime)) {
+                coins.Deactivate(coin);
+                coinsCollected++;
+                int coinValue = 100 + static_cast<int>(GetUpgradeValue(UpgradeType::COIN_VALUE));
+                score += coinValue * modifiers.scoreMultiplier;
+            }
+        }
+    }
+
+    for (const auto& event : dueEvents) {
+        if (event.kind != CollisionKind::POWER_UP) continue;
+        size_t powerUp = powerUps.Find(event.id);
+        if (powerUp != EntityColumns::npos) {
+            // Для усилений используем проверку сферы
+            Vec3 previousPosition = powerUps.GetPreviousPosition(powerUp);
+            Scalar hitTime;
+            if (SweepBoxSphere(playerFrontBox, playerMove, previousPosition,
+                Subtract(powerUps.GetPosition(powerUp), previousPosition), pickupRadius, hitTime)) {
+                powerUps.Deactivate(powerUp);
+                ApplyPowerUp(powerUps.GetType(powerUp));
+            }
+        }
+    }
+}
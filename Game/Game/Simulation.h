@@ -0,0 +1,428 @@
+﻿#pragma once
+
+#include "SimMath.h"
+#include "Random.h"
+#include "Difficulty.h"
+#include "CollisionScheduler.h"
+#include "TimerWheel.h"
+#include "Trajectory.h"
+#include "Crowd.h"
+#include "Entities.h"
+#include "RingBuffer.h"
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Ядро игровой логики: состояние мира и его обновление по тикам.
+// Не зависит от raylib - нет окна, OpenGL-контекста и текстур,
+// поэтому может работать без графики (балансировка, CI).
+
+const int powerUpTypeCount = 4;
+
+inline uint32_t PowerUpBit(PowerUpType type) {
+    return 1u << static_cast<int>(type);
+}
+
+// Улучшения из магазина, влияющие на симуляцию (порядок как в Shop::upgrades)
+enum class UpgradeType {
+    SPEED_BOOST,
+    INVINCIBILITY,
+    MAGNET,
+    DOUBLE_POINTS,
+    COIN_VALUE
+};
+
+const int upgradeCount = 5;
+
+// Значение улучшения на первом уровне и прирост за каждый следующий уровень
+struct UpgradeCurve {
+    Scalar baseValue;
+    Scalar increment;
+};
+
+const UpgradeCurve upgradeCurves[upgradeCount] = {
+    { 2.5f, 2.5f },     // Speed Boost: +2.5 секунды за уровень
+    { 2.5f, 2.5f },     // Invincibility
+    { 2.5f, 2.5f },     // Coin Magnet
+    { 2.5f, 2.5f },     // Double Points
+    { 100.0f, 25.0f }   // Coin Value
+};
+
+inline Scalar GetUpgradeValue(UpgradeType type, int level) {
+    const UpgradeCurve& curve = upgradeCurves[static_cast<int>(type)];
+    return curve.baseValue + curve.increment * (level - 1);
+}
+
+// Ввод, накопленный за кадр и применяемый на ближайшем тике симуляции
+struct InputState {
+    bool left;
+    bool right;
+    bool jump;
+    bool roll;
+};
+
+// Компактная форма ввода - по биту на кнопку (для записи повторов)
+enum InputBit : uint8_t {
+    INPUT_LEFT = 1 << 0,
+    INPUT_RIGHT = 1 << 1,
+    INPUT_JUMP = 1 << 2,
+    INPUT_ROLL = 1 << 3
+};
+
+inline uint8_t PackInput(const InputState& input) {
+    return static_cast<uint8_t>((input.left ? INPUT_LEFT : 0) | (input.right ? INPUT_RIGHT : 0) |
+        (input.jump ? INPUT_JUMP : 0) | (input.roll ? INPUT_ROLL : 0));
+}
+
+inline InputState UnpackInput(uint8_t bits) {
+    InputState input;
+    input.left = (bits & INPUT_LEFT) != 0;
+    input.right = (bits & INPUT_RIGHT) != 0;
+    input.jump = (bits & INPUT_JUMP) != 0;
+    input.roll = (bits & INPUT_ROLL) != 0;
+    return input;
+}
+
+// Описание усиления: сколько длится и что меняет в характеристиках.
+// Новый тип усиления - новая строка в powerUpInfos, а не ветка switch
+struct PowerUpInfo {
+    UpgradeType upgrade;     // Улучшение из магазина, продлевающее эффект
+    Scalar baseDuration;
+    Scalar speedMultiplier;
+    int scoreMultiplier;
+    bool magnet;
+    bool invincible;
+};
+
+const PowerUpInfo powerUpInfos[powerUpTypeCount] = {
+    { UpgradeType::SPEED_BOOST, 5.0f, 1.5f, 1, false, false },
+    { UpgradeType::INVINCIBILITY, 5.0f, 1.0f, 1, false, true },
+    { UpgradeType::MAGNET, 8.0f, 1.0f, 1, true, false },   // Магнит длится дольше
+    { UpgradeType::DOUBLE_POINTS, 5.0f, 1.0f, 2, false, false }
+};
+
+// Слот активного эффекта (по одному на PowerUpType)
+struct ActivePowerUp {
+    TimerHandle timer; // Окончание эффекта (POWER_UP_END)
+    Scalar duration;
+
+    ActivePowerUp() : timer(noTimer), duration(0) {}
+};
+
+// Суммарное влияние активных усилений - пересчитывается при изменении
+// набора эффектов, чтобы горячие циклы не перебирали их каждый раз
+struct PowerUpModifiers {
+    Scalar speedMultiplier;
+    int scoreMultiplier;
+    Scalar magnetRange; // 0 - магнит не активен
+    bool invincible;
+};
+
+// Траектория прыжка в замкнутой форме: высота считается по времени с
+// отрыва, а не накоплением скорости, поэтому не зависит от длины тика.
+// Приземление (момент и поверхность) предсказывается один раз при отрыве
+// и пересчитывается, только когда в полосе что-то меняется
+struct JumpArc {
+    Scalar startHeight;
+    Scalar startVelocity;
+    Scalar gravity;
+    Scalar time;          // Сколько прошло с отрыва
+    Scalar landingTime;   // Предсказанный момент приземления (от отрыва)
+    Scalar landingHeight;
+    bool landsOnObstacle;
+    bool needsPrediction; // Полоса или препятствия изменились - пересчитать
+};
+
+inline Scalar JumpHeightAt(const JumpArc& arc, Scalar t) {
+    return arc.startHeight + arc.startVelocity * t - 0.5f * arc.gravity * t * t;
+}
+
+inline Scalar JumpVelocityAt(const JumpArc& arc, Scalar t) {
+    return arc.startVelocity - arc.gravity * t;
+}
+
+// Момент на нисходящей ветви, когда дуга опустится до height; -1, если не достает
+inline Scalar JumpDescentTime(const JumpArc& arc, Scalar height) {
+    Scalar discriminant = arc.startVelocity * arc.startVelocity + 2.0f * arc.gravity * (arc.startHeight - height);
+    if (discriminant < 0.0f) return -1.0f;
+    return (arc.startVelocity + Sqrt(discriminant)) / arc.gravity;
+}
+
+// Структура для игрока
+struct Player {
+    Vec3 position;
+    Vec3 previousPosition; // Позиция на предыдущем тике (для интерполяции)
+    Vec3 size;
+    Scalar speed;
+    int lane; // 0 - крайняя левая, GetLaneCount() - 1 - крайняя правая
+    int targetLane; // Целевая полоса для плавного перемещения
+    bool isJumping;
+    bool isRolling; // ЗАМЕНА: вместо isDucking теперь isRolling
+    Scalar jumpVelocity; // Текущая вертикальная скорость (из jump)
+    JumpArc jump;
+    Scalar gravity;
+    bool isOnObstacle; // Находится ли на препятствии
+    Scalar laneChangeSpeed; // Скорость перемещения между полосами
+    TimerHandle rollCooldownTimer; // Кулдаун переката: пока активен, катиться нельзя
+
+    // Эффекты усилений (теперь могут комбинироваться): слот на каждый
+    // тип и маска активных, бит PowerUpBit(type)
+    Scalar originalSpeed;
+    uint32_t activePowerUps;
+    ActivePowerUp powerUps[powerUpTypeCount];
+
+    // Состояние падения
+    bool isFalling;
+    bool isLyingDown; // Долетел до земли и лежит
+    TimerHandle fallTimer; // До конца падения (FALL_END)
+    Scalar fallRotation; // Вращение при падении
+};
+
+// Персонаж-компаньон (только логика, внешний вид хранит Game).
+// Своей физики нет: каждый тик берет состояние игрока из истории с
+// задержкой, поэтому проходит трассу ровно по его пути
+struct Companion {
+    Vec3 position;
+    Vec3 previousPosition;
+    Vec3 size;
+    Vec3 originalSize; // Сохраняем оригинальный размер
+    int lane;
+    bool isActive;
+    Scalar followDistance; // Дистанция следования за игроком (ПОЛОЖИТЕЛЬНАЯ - значит СЗАДИ)
+    uint32_t delayTicks;   // Отставание от игрока в тиках истории
+
+    // Состояния, взятые у игрока
+    bool isJumping;
+    bool isRolling;
+
+    // Поведение (переключается таймерами симуляции)
+    bool isFallingBehind; // Первые 5 секунд бежит рядом, потом отстает
+    bool isCatchingUp;    // Флаг режима догоняния
+
+    // Конструктор
+    Companion() : position({ 0, 0, 0 }), previousPosition({ 0, 0, 0 }), size({ 0.8f, 1.6f, 0.8f }), originalSize({ 0.8f, 1.6f, 0.8f }),
+        lane(1), isActive(false), followDistance(3.0f), delayTicks(0),
+        isJumping(false), isRolling(false), isFallingBehind(false), isCatchingUp(false) {}
+};
+
+// Номера независимых потоков случайных чисел: лишний вызов в одном
+// спавнере не сдвигает последовательности остальных
+enum class RandomStream {
+    OBSTACLES,
+    COINS,
+    POWER_UPS
+};
+
+// Допустимое число полос трассы
+const int minLaneCount = 3;
+const int maxLaneCount = 16;
+
+// Емкость хранилищ объектов трассы - с большим запасом на 16 полос и
+// плотную кривую сложности. Память выделяется один раз в конструкторе;
+// если хранилище все же полно, спавн пропускается
+const size_t obstacleCapacity = 1024;
+const size_t coinCapacity = 256;
+const size_t powerUpCapacity = 64;
+
+// Настраиваемые параметры мира (скорость и частота спавна - в DifficultyCurve)
+struct SimConfig {
+    // Константы для дальности спавна
+    Scalar spawnDistance;
+    Scalar despawnDistance;
+
+    Scalar laneWidth;
+    int laneCount; // От minLaneCount до maxLaneCount, трасса центрирована по X = 0
+    Scalar scorePerSecond; // Очки за время бега
+
+    SimConfig() : spawnDistance(-30.0f), despawnDistance(15.0f),
+        laneWidth(4.0f), laneCount(3), scorePerSecond(60.0f) {}
+};
+
+// Препятствие в очереди полосы и отрезок пути, на котором его передняя
+// грань задевает переднюю грань игрока (как у CollisionScheduler)
+struct LaneObstacle {
+    uint32_t id;
+    Distance enterDistance;
+    Distance exitDistance;
+};
+
+// Данные одной полосы. Запросы идут только по полосам рядом с игроком,
+// поэтому их цена не растет с шириной трассы.
+// Препятствия одной глубины едут с общей скоростью и появляются у
+// дальнего края, поэтому подходят к игроку в порядке спавна: очередь
+// полосы отсортирована по Z, а прошедшие игрока снимаются с головы.
+// Ближайшее препятствие полосы - всегда голова очереди
+struct TrackLane {
+    CollisionScheduler collisions; // Монеты и усиления полосы, еще не прошедшие игрока
+    RingBuffer<LaneObstacle> obstacles; // Еще не прошедшие игрока, от ближнего к дальнему
+};
+
+class Simulation {
+public:
+    Simulation();
+    explicit Simulation(const SimConfig& config, uint64_t seed = 0);
+
+    // Сброс забега (монеты, еще не отнесенные в магазин, сохраняются).
+    // Без аргумента трасса повторяет предыдущую с тем же seed
+    void Reset();
+    void Reset(uint64_t seed);
+
+    // Один тик симуляции фиксированной длительности. Со второго тика забега
+    // память не выделяется (в отладочной сборке это проверяет assert)
+    void Step(Scalar dt, const InputState& input);
+
+    void SetUpgradeLevel(UpgradeType type, int level);
+    int GetUpgradeLevel(UpgradeType type) const { return upgradeLevels[static_cast<int>(type)]; }
+    Scalar GetUpgradeValue(UpgradeType type) const;
+
+    bool HasPowerUp(PowerUpType type) const { return (player.activePowerUps & PowerUpBit(type)) != 0; }
+    const PowerUpModifiers& GetPowerUpModifiers() const { return modifiers; }
+
+    // Таймеры из состояния (Player::fallTimer и т.п.) для интерфейса и бота
+    bool IsTimerActive(TimerHandle timer) const { return timers.IsActive(timer); }
+    Scalar GetTimeLeft(TimerHandle timer) const;
+
+    uint64_t GetSeed() const { return seed; }
+
+    // Снимок всего состояния мира в буфер вызывающего (формат - Snapshot.h).
+    // Save возвращает число записанных байт или 0, если буфер мал.
+    // Load не выделяет память, пока хватает емкости векторов; при false
+    // состояние не определено и забег нужно сбросить
+    size_t GetSnapshotSize() const;
+    size_t SaveSnapshot(uint8_t* buffer, size_t capacity) const;
+    bool LoadSnapshot(const uint8_t* data, size_t size);
+
+    // Кривая сложности - данные, а не состояние: в снимки не попадает
+    void SetDifficultyCurve(const DifficultyCurve& curve) { difficulty = curve; }
+    const DifficultyCurve& GetDifficultyCurve() const { return difficulty; }
+    const DifficultyLevel& GetDifficulty() const { return currentDifficulty; }
+    Distance GetDistance() const { return distance; } // Пройденный путь с начала забега
+
+    const SimConfig& GetConfig() const { return config; }
+    const Player& GetPlayer() const { return player; }
+    const Companion& GetCompanion() const { return companion; }
+    const Trajectory& GetPlayerTrajectory() const { return playerTrajectory; }
+
+    // Режим "забег толпой": count последователей за игроком (0 - выключен).
+    // Толпа только повторяет путь игрока и на игру не влияет, поэтому в
+    // снимки и повторы не попадает; переживает Reset
+    void SetCrowdSize(int count);
+    const Crowd& GetCrowd() const { return crowd; }
+    const ObstacleStore& GetObstacles() const { return obstacles; }
+    const CoinStore& GetCoins() const { return coins; }
+    const PowerUpStore& GetPowerUps() const { return powerUps; }
+
+    uint32_t GetTick() const { return tick; } // Сколько тиков прошло с начала забега
+    int GetScore() const { return score; }
+    int GetCoinsCollected() const { return coinsCollected; }
+    void ResetCoinsCollected() { coinsCollected = 0; }
+    bool IsGameOver() const { return gameOver; }
+    ObstacleType GetDeathCause() const { return deathCause; } // Имеет смысл только после game over
+    Scalar GetGameSpeed() const { return currentDifficulty.speed; } // Скорость мира на текущем тике
+    Scalar GetEnvironmentOffset() const { return environmentOffset; }
+    Scalar GetPreviousEnvironmentOffset() const { return previousEnvironmentOffset; }
+    Scalar GetLaneWidth() const { return config.laneWidth; }
+    Scalar GetLanePosition(int lane) const { return lanePositions[lane]; }
+    int GetLaneCount() const { return config.laneCount; }
+
+    // Число полос (приводится к [minLaneCount, maxLaneCount]); трасса
+    // перестраивается сразу, поэтому вызывать между забегами - следом Reset
+    void SetLaneCount(int count);
+
+    // Препятствия полосы, еще не прошедшие игрока, - от ближнего к дальнему
+    const RingBuffer<LaneObstacle>& GetLaneObstacles(int lane) const { return lanes[lane].obstacles; }
+    bool FindObstacle(uint32_t id, Obstacle& obstacle) const;
+
+private:
+    SimConfig config;
+
+    Player player;
+    Companion companion;
+    Trajectory playerTrajectory; // Состояние игрока по тикам - по нему бегут компаньон и толпа
+    Crowd crowd;
+    ObstacleStore obstacles;
+    CoinStore coins;
+    PowerUpStore powerUps;
+
+    // Производное от player.activePowerUps и улучшений, в снимки не пишется
+    PowerUpModifiers modifiers;
+
+    uint32_t nextEntityId;
+
+    // Все таймеры забега; длительности переводятся в тики по частоте
+    // тиков, которую задает Step
+    TimerWheel timers;
+    int ticksPerSecond;
+
+    // Полосы: когда какой объект дойдет до игрока и препятствия по полосам.
+    // В снимки не пишутся, восстанавливаются по объектам
+    std::vector<TrackLane> lanes;
+    CollisionScheduler attractedCoins; // Монеты, которые магнит увел из полосы
+    std::vector<size_t> magnetCandidates; // Монеты в радиусе магнита по Z (UpdateCoins)
+    std::vector<CollisionEvent> dueEvents; // События тика со всех опрошенных полос
+
+    uint32_t tick;
+    int score;
+    Scalar scoreAccumulator;
+    int coinsCollected;
+    bool gameOver;
+    ObstacleType deathCause; // Препятствие, о которое разбился игрок
+
+    Scalar lanePositions[maxLaneCount];
+    DifficultyCurve difficulty;
+    DifficultyLevel currentDifficulty;
+    Distance distance;
+    Scalar environmentOffset;
+    Scalar previousEnvironmentOffset;
+
+    int upgradeLevels[upgradeCount];
+
+    uint64_t seed;
+    Random obstacleRandom;
+    Random coinRandom;
+    Random powerUpRandom;
+
+    void SeedStreams();
+    void ApplyLaneCount();
+    int GetLaneAt(Scalar x) const;
+
+    template <typename Archive>
+    void Serialize(Archive& archive);
+
+    void SavePreviousState();
+    void ResetEntityScroll();
+    uint32_t ToTicks(Scalar seconds) const;
+    void StartRunTimers();
+    void FireTimers();
+    void OnTimer(const TimerFired& timer);
+    void EndPowerUp(PowerUpType type);
+    void HandleInput(const InputState& input);
+    void UpdatePlayer(Scalar dt);
+    void UpdatePlayerFall(Scalar dt);
+    void RecordTrajectory();
+    void UpdateCompanion();
+    void UpdateCrowd();
+    void ReserveTrajectory();
+    void UpdateObstacles(Distance scroll);
+    void SpawnSingleObstacle();
+    void SpawnObstacleGroup();
+    void AddObstacle(int lane, ObstacleType type);
+    void UpdateCoins(Scalar dt, Distance scroll);
+    void SpawnCoin();
+    void UpdatePowerUps(Distance scroll);
+    void SpawnPowerUp();
+    void ApplyPowerUp(PowerUpType type);
+    void UpdatePowerUpModifiers();
+    void CheckCollisions(Scalar dt);
+    void GetContactWindow(Scalar z, Scalar zLow, Scalar zHigh, Distance scroll, Distance& enter, Distance& exit) const;
+    void ScheduleCollision(int lane, CollisionKind kind, uint32_t id, Scalar z, Scalar zLow, Scalar zHigh, Distance scroll);
+    void QueueObstacle(int lane, uint32_t id, Scalar z, Scalar halfDepth);
+    void RebuildLanes();
+    bool IsStateValid() const; // Полосы и типы объектов после загрузки снимка
+
+    void StartJump(JumpArc& arc, Scalar startHeight, Scalar velocity, Scalar gravity);
+    void PredictLanding(JumpArc& arc, int lane, Scalar frontZ) const;
+    void InvalidateLandingPredictions();
+    Box GetPlayerFrontFaceBox() const;
+    Box GetObstacleFrontFaceBox(const Obstacle& obstacle) const;
+};
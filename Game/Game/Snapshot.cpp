@@ -0,0 +1,172 @@
+﻿#include "Simulation.h"
+#include "Snapshot.h"
+
+template <typename Archive>
+static void SerializeActivePowerUp(Archive& archive, ActivePowerUp& effect) {
+    archive(effect.timer);
+    archive(effect.duration);
+}
+
+template <typename Archive>
+static void SerializeJumpArc(Archive& archive, JumpArc& arc) {
+    archive(arc.startHeight);
+    archive(arc.startVelocity);
+    archive(arc.gravity);
+    archive(arc.time);
+    archive(arc.landingTime);
+    archive(arc.landingHeight);
+    archive(arc.landsOnObstacle);
+    archive(arc.needsPrediction);
+}
+
+template <typename Archive>
+static void SerializePlayer(Archive& archive, Player& player) {
+    archive(player.position);
+    archive(player.previousPosition);
+    archive(player.size);
+    archive(player.speed);
+    archive(player.lane);
+    archive(player.targetLane);
+    archive(player.isJumping);
+    archive(player.isRolling);
+    archive(player.jumpVelocity);
+    SerializeJumpArc(archive, player.jump);
+    archive(player.gravity);
+    archive(player.isOnObstacle);
+    archive(player.laneChangeSpeed);
+    archive(player.rollCooldownTimer);
+    archive(player.originalSpeed);
+    archive(player.activePowerUps);
+    for (int i = 0; i < powerUpTypeCount; i++) SerializeActivePowerUp(archive, player.powerUps[i]);
+    archive(player.isFalling);
+    archive(player.isLyingDown);
+    archive(player.fallTimer);
+    archive(player.fallRotation);
+}
+
+template <typename Archive>
+static void SerializeCompanion(Archive& archive, Companion& companion) {
+    archive(companion.position);
+    archive(companion.previousPosition);
+    archive(companion.size);
+    archive(companion.originalSize);
+    archive(companion.lane);
+    archive(companion.isActive);
+    archive(companion.followDistance);
+    archive(companion.delayTicks);
+    archive(companion.isJumping);
+    archive(companion.isRolling);
+    archive(companion.isFallingBehind);
+    archive(companion.isCatchingUp);
+}
+
+template <typename Archive>
+static void SerializeConfig(Archive& archive, SimConfig& config) {
+    archive(config.spawnDistance);
+    archive(config.despawnDistance);
+    archive(config.laneWidth);
+    archive(config.laneCount);
+    archive(config.scorePerSecond);
+}
+
+// Порядок полей - это и есть формат снимка: при изменении поднимать snapshotVersion
+template <typename Archive>
+void Simulation::Serialize(Archive& archive) {
+    SerializeConfig(archive, config);
+    SerializePlayer(archive, player);
+    SerializeCompanion(archive, companion);
+    playerTrajectory.Serialize(archive);
+    obstacles.Serialize(archive);
+    coins.Serialize(archive);
+    powerUps.Serialize(archive);
+
+    archive(nextEntityId);
+    timers.Serialize(archive);
+    archive(ticksPerSecond);
+
+    archive(tick);
+    archive(score);
+    archive(scoreAccumulator);
+    archive(coinsCollected);
+    archive(gameOver);
+    archive(deathCause);
+
+    archive(distance);
+    archive(currentDifficulty.speed);
+    archive(currentDifficulty.obstacleSpawnInterval);
+    archive(currentDifficulty.coinSpawnInterval);
+    archive(currentDifficulty.powerUpSpawnInterval);
+    archive(environmentOffset);
+    archive(previousEnvironmentOffset);
+
+    for (int i = 0; i < upgradeCount; i++) archive(upgradeLevels[i]);
+
+    archive(seed);
+    obstacleRandom.Serialize(archive);
+    coinRandom.Serialize(archive);
+    powerUpRandom.Serialize(archive);
+}
+
+// Заголовок: сигнатура, версия и полный размер снимка
+template <typename Archive>
+static void SerializeHeader(Archive& archive, uint32_t& magic, uint16_t& version, uint32_t& size) {
+    archive(magic);
+    archive(version);
+    archive(size);
+}
+
+size_t Simulation::GetSnapshotSize() const {
+    uint32_t magic = snapshotMagic;
+    uint16_t version = snapshotVersion;
+    uint32_t size = 0;
+
+    SnapshotSizer sizer;
+    SerializeHeader(sizer, magic, version, size);
+    // Serialize только читает состояние, когда архив пишет
+    const_cast<Simulation*>(this)->Serialize(sizer);
+    return sizer.GetSize();
+}
+
+size_t Simulation::SaveSnapshot(uint8_t* buffer, size_t capacity) const {
+    uint32_t magic = snapshotMagic;
+    uint16_t version = snapshotVersion;
+    uint32_t size = 0;
+
+    SnapshotWriter writer(buffer, capacity);
+    SerializeHeader(writer, magic, version, size);
+    const_cast<Simulation*>(this)->Serialize(writer);
+    if (!writer.IsOk()) return 0;
+
+    // Размер известен только в конце - дописываем его в заголовок
+    size = static_cast<uint32_t>(writer.GetSize());
+    std::memcpy(buffer + sizeof(magic) + sizeof(version), &size, sizeof(size));
+    return size;
+}
+
+bool Simulation::LoadSnapshot(const uint8_t* data, size_t size) {
+    uint32_t magic = 0;
+    uint16_t version = 0;
+    uint32_t storedSize = 0;
+
+    SnapshotReader reader(data, size);
+    SerializeHeader(reader, magic, version, storedSize);
+    if (!reader.IsOk() || magic != snapshotMagic || version != snapshotVersion || storedSize != size) {
+        return false;
+    }
+
+    Serialize(reader);
+    if (!reader.IsOk() || reader.GetPosition() != size) return false;
+    if (!timers.RestoreBuckets()) return false;
+    if (!playerTrajectory.IsConsistent()) return false;
+    if (!IsStateValid()) return false;
+
+    // Позиции объектов считаются от пройденного пути - он и есть путь мира
+    ResetEntityScroll();
+
+    // Позиции полос выводятся из config; память выделяется, только если
+    // в снимке другое число полос
+    ApplyLaneCount();
+    RebuildLanes();
+    UpdatePowerUpModifiers();
+    return true;
+}
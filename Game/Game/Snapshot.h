@@ -0,0 +1,140 @@
+﻿#pragma once
+
+#include "SimMath.h"
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
+#include <vector>
+
+// Снимок состояния симуляции - плоский бинарный блок без выравнивания и
+// мусора в паддингах. Числа лежат в порядке байт машины (все наши
+// платформы little-endian), float копируется побитово, поэтому
+// восстановление точное. Состояние обходится один раз шаблонной функцией
+// Serialize, которая одинаково работает с тремя "архивами" ниже:
+// подсчет размера, запись в чужой буфер и чтение из него.
+
+// Снимки float- и fixed-сборок несовместимы: у них разные сигнатуры
+#ifdef GAME_FIXED_POINT
+const uint32_t snapshotMagic = 0x46504E53; // "SNPF"
+#else
+const uint32_t snapshotMagic = 0x50414E53; // "SNAP"
+#endif
+const uint16_t snapshotVersion = 12;
+
+// Считает размер снимка, ничего не пишет
+class SnapshotSizer {
+public:
+    SnapshotSizer() : size(0) {}
+
+    template <typename T>
+    void operator()(T&) {
+        static_assert(std::is_arithmetic<T>::value || std::is_enum<T>::value, "only plain values");
+        size += sizeof(T);
+    }
+    void operator()(Vec3&) { size += 3 * sizeof(Scalar); }
+#ifdef GAME_FIXED_POINT
+    void operator()(Fixed& value) { operator()(value.raw); }
+    void operator()(FixedDistance& value) { operator()(value.raw); }
+#endif
+    void Count(uint32_t&, size_t) { size += sizeof(uint32_t); }
+
+    size_t GetSize() const { return size; }
+    bool IsReading() const { return false; }
+
+private:
+    size_t size;
+};
+
+// Пишет снимок в буфер вызывающего; при нехватке места ok() == false
+class SnapshotWriter {
+public:
+    SnapshotWriter(uint8_t* data, size_t capacity) : data(data), capacity(capacity), size(0), ok(true) {}
+
+    template <typename T>
+    void operator()(T& value) {
+        static_assert(std::is_arithmetic<T>::value || std::is_enum<T>::value, "only plain values");
+        Bytes(&value, sizeof(T));
+    }
+    void operator()(Vec3& value) {
+        operator()(value.x);
+        operator()(value.y);
+        operator()(value.z);
+    }
+#ifdef GAME_FIXED_POINT
+    void operator()(Fixed& value) { operator()(value.raw); }
+    void operator()(FixedDistance& value) { operator()(value.raw); }
+#endif
+    void Count(uint32_t& count, size_t) { operator()(count); }
+
+    size_t GetSize() const { return size; }
+    bool IsOk() const { return ok; }
+    bool IsReading() const { return false; }
+
+private:
+    uint8_t* data;
+    size_t capacity;
+    size_t size;
+    bool ok;
+
+    void Bytes(const void* source, size_t count) {
+        if (!ok || capacity - size < count) {
+            ok = false;
+            return;
+        }
+        std::memcpy(data + size, source, count);
+        size += count;
+    }
+};
+
+// Читает снимок; обрезанные или испорченные данные дают ok() == false
+class SnapshotReader {
+public:
+    SnapshotReader(const uint8_t* data, size_t size) : data(data), size(size), position(0), ok(true) {}
+
+    template <typename T>
+    void operator()(T& value) {
+        static_assert(std::is_arithmetic<T>::value || std::is_enum<T>::value, "only plain values");
+        Bytes(&value, sizeof(T));
+    }
+    void operator()(bool& value) {
+        uint8_t byte = 0;
+        Bytes(&byte, 1);
+        if (byte > 1) ok = false;
+        value = byte != 0;
+    }
+    void operator()(Vec3& value) {
+        operator()(value.x);
+        operator()(value.y);
+        operator()(value.z);
+    }
+#ifdef GAME_FIXED_POINT
+    void operator()(Fixed& value) { operator()(value.raw); }
+    void operator()(FixedDistance& value) { operator()(value.raw); }
+#endif
+    // Не даем испорченному счетчику раздуть вектор больше, чем осталось данных
+    void Count(uint32_t& count, size_t minElementSize) {
+        operator()(count);
+        if (ok && static_cast<size_t>(count) * minElementSize > size - position) ok = false;
+        if (!ok) count = 0;
+    }
+
+    size_t GetPosition() const { return position; }
+    bool IsOk() const { return ok; }
+    bool IsReading() const { return true; }
+
+private:
+    const uint8_t* data;
+    size_t size;
+    size_t position;
+    bool ok;
+
+    void Bytes(void* target, size_t count) {
+        if (!ok || size - position < count) {
+            ok = false;
+            return;
+        }
+        std::memcpy(target, data + position, count);
+        position += count;
+    }
+};
@@ -0,0 +1,164 @@
+﻿#include "TimerWheel.h"
+
+static const uint32_t indexMask = 0xFFFF;
+static const int32_t maxNodes = 0xFFFF;
+
+void TimerWheel::Reserve(size_t capacity) {
+    nodes.reserve(capacity);
+    fired.reserve(capacity);
+}
+
+void TimerWheel::Clear() {
+    nodes.clear();
+    fired.clear();
+    for (auto& head : heads) head = -1;
+    freeHead = -1;
+    now = 0;
+}
+
+TimerHandle TimerWheel::Schedule(TimerEvent event, uint32_t payload, uint32_t delayTicks) {
+    int32_t index = freeHead;
+    if (index >= 0) {
+        freeHead = nodes[index].next;
+    }
+    else {
+        if (static_cast<int32_t>(nodes.size()) >= maxNodes) return noTimer;
+        index = static_cast<int32_t>(nodes.size());
+        TimerNode node = TimerNode();
+        node.generation = 1;
+        nodes.push_back(node);
+    }
+
+    TimerNode& node = nodes[index];
+    node.event = event;
+    node.payload = payload;
+    node.expireTick = now + (delayTicks < 1 ? 1 : (delayTicks > maxDelay ? maxDelay : delayTicks));
+    Link(index);
+    return (static_cast<uint32_t>(node.generation) << 16) | static_cast<uint32_t>(index);
+}
+
+bool TimerWheel::Cancel(TimerHandle handle) {
+    int32_t index = FindIndex(handle);
+    if (index < 0) return false;
+    Unlink(index);
+    Release(index);
+    return true;
+}
+
+bool TimerWheel::Reschedule(TimerHandle handle, uint32_t delayTicks) {
+    int32_t index = FindIndex(handle);
+    if (index < 0) return false;
+    Unlink(index);
+    nodes[index].expireTick = now + (delayTicks < 1 ? 1 : (delayTicks > maxDelay ? maxDelay : delayTicks));
+    Link(index);
+    return true;
+}
+
+uint32_t TimerWheel::GetTicksLeft(TimerHandle handle) const {
+    int32_t index = FindIndex(handle);
+    return index < 0 ? 0 : nodes[index].expireTick - now;
+}
+
+const std::vector<TimerFired>& TimerWheel::Advance() {
+    fired.clear();
+    uint32_t tick = now + 1;
+
+    // Начался новый круг младшего уровня - спускаем вниз корзину следующего
+    // уровня, а если и там круг начался - следующего за ним
+    for (int level = 1; level < levelCount; level++) {
+        uint32_t lowerSlot = (tick >> (levelBits * (level - 1))) & (levelSize - 1);
+        if (lowerSlot != 0) break;
+
+        int slot = static_cast<int>((tick >> (levelBits * level)) & (levelSize - 1));
+        for (int32_t index = Detach(level * levelSize + slot); index >= 0; ) {
+            int32_t next = nodes[index].next;
+            Link(index);
+            index = next;
+        }
+    }
+
+    // Link считает от now + 1, поэтому now двигаем только после спуска
+    now = tick;
+
+    for (int32_t index = Detach(static_cast<int>(tick & (levelSize - 1))); index >= 0; ) {
+        int32_t next = nodes[index].next;
+        TimerFired timer;
+        timer.event = nodes[index].event;
+        timer.payload = nodes[index].payload;
+        fired.push_back(timer);
+        Release(index);
+        index = next;
+    }
+    return fired;
+}
+
+bool TimerWheel::RestoreBuckets() {
+    int32_t count = static_cast<int32_t>(nodes.size());
+    if (freeHead < -1 || freeHead >= count) return false;
+
+    for (auto& head : heads) head = -1;
+    for (int32_t i = 0; i < count; i++) {
+        const TimerNode& node = nodes[i];
+        if (node.next < -1 || node.next >= count || node.prev < -1 || node.prev >= count) return false;
+        if (node.bucket == freeBucket) continue;
+        if (node.bucket >= bucketCount) return false;
+        if (node.prev < 0) {
+            if (heads[node.bucket] >= 0) return false;
+            heads[node.bucket] = i;
+        }
+    }
+    return true;
+}
+
+int32_t TimerWheel::FindIndex(TimerHandle handle) const {
+    int32_t index = static_cast<int32_t>(handle & indexMask);
+    if (handle == noTimer || index >= static_cast<int32_t>(nodes.size())) return -1;
+
+    const TimerNode& node = nodes[index];
+    if (node.bucket == freeBucket || node.generation != (handle >> 16)) return -1;
+    return index;
+}
+
+// Уровень - по тому, сколько осталось ждать: чем дальше срок, тем крупнее
+// корзина. Слот - по абсолютному тику, поэтому корзины не надо сдвигать
+void TimerWheel::Link(int32_t index) {
+    TimerNode& node = nodes[index];
+    uint32_t delta = node.expireTick - (now + 1);
+
+    int level = 0;
+    while (level < levelCount - 1 && delta >= (1u << (levelBits * (level + 1)))) {
+        level++;
+    }
+    int slot = static_cast<int>((node.expireTick >> (levelBits * level)) & (levelSize - 1));
+    node.bucket = static_cast<uint16_t>(level * levelSize + slot);
+
+    node.prev = -1;
+    node.next = heads[node.bucket];
+    if (node.next >= 0) nodes[node.next].prev = index;
+    heads[node.bucket] = index;
+}
+
+void TimerWheel::Unlink(int32_t index) {
+    TimerNode& node = nodes[index];
+    if (node.prev >= 0) nodes[node.prev].next = node.next;
+    else heads[node.bucket] = node.next;
+    if (node.next >= 0) nodes[node.next].prev = node.prev;
+}
+
+// Узел уходит в список свободных с новым поколением (0 пропускаем - это noTimer)
+void TimerWheel::Release(int32_t index) {
+    TimerNode& node = nodes[index];
+    node.bucket = freeBucket;
+    node.prev = -1;
+    node.next = freeHead;
+    node.generation++;
+    if (node.generation == 0) node.generation = 1;
+    freeHead = index;
+}
+
+// Забирает всю корзину целиком; возвращает первый узел цепочки
+int32_t TimerWheel::Detach(int bucket) {
+    int32_t index = heads[bucket];
+    heads[bucket] = -1;
+    return index;
+}
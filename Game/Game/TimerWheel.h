@@ -0,0 +1,120 @@
+﻿#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Иерархическое колесо таймеров: все игровые таймеры (перекат, падение,
+// усиления, спавн) живут здесь и считаются в тиках, а не вычитанием dt
+// каждый кадр. Установка, отмена и перенос - O(1), за тик разбирается одна
+// корзина первого уровня; дальние таймеры лежат на верхних уровнях и
+// спускаются вниз, когда до них доходит очередь (как timer wheel в ядре Linux).
+// 4 уровня по 64 корзины покрывают 2^24 тиков - почти 39 часов на 120 Гц.
+
+// Что делать по таймеру - разбирает Simulation::OnTimer. Событие - это
+// данные, а не указатель на функцию, поэтому колесо целиком попадает в снимки
+enum class TimerEvent : uint8_t {
+    NONE,                  // Просто отсчет: проверяется через IsActive
+    ROLL_END,
+    FALL_LIE_DOWN,         // Персонаж долетел до земли
+    FALL_END,
+    COMPANION_FALL_BEHIND, // Компаньон перестает бежать рядом
+    POWER_UP_END,          // payload - PowerUpType
+    OBSTACLE_SPAWN,
+    COIN_SPAWN,
+    POWER_UP_SPAWN
+};
+
+// Номер узла в младших 16 битах, поколение - в старших. Узел после
+// срабатывания или отмены получает новое поколение, поэтому устаревший
+// хэндл просто не находит таймер
+typedef uint32_t TimerHandle;
+const TimerHandle noTimer = 0;
+
+struct TimerFired {
+    TimerEvent event;
+    uint32_t payload;
+};
+
+class TimerWheel {
+public:
+    static const int levelBits = 6;
+    static const int levelSize = 1 << levelBits;
+    static const int levelCount = 4;
+    static const int bucketCount = levelSize * levelCount;
+    static const uint32_t maxDelay = 1u << (levelBits * levelCount);
+
+    TimerWheel() { Clear(); }
+
+    void Reserve(size_t capacity);
+    void Clear();
+
+    // Сработает через delayTicks вызовов Advance (0 считается как 1).
+    // Возвращает noTimer, если закончились номера узлов
+    TimerHandle Schedule(TimerEvent event, uint32_t payload, uint32_t delayTicks);
+
+    // Отмена и перенос (продление или сокращение) уже заведенного таймера.
+    // false - таймер уже сработал или отменен
+    bool Cancel(TimerHandle handle);
+    bool Reschedule(TimerHandle handle, uint32_t delayTicks);
+
+    bool IsActive(TimerHandle handle) const { return FindIndex(handle) >= 0; }
+    uint32_t GetTicksLeft(TimerHandle handle) const;
+    uint32_t GetTick() const { return now; }
+
+    // Следующий тик: возвращает сработавшие в нем таймеры (уже снятые с
+    // колеса). Вектор живет до следующего Advance
+    const std::vector<TimerFired>& Advance();
+
+    // Состояние для снимков (см. Snapshot.h): узлы пишутся вместе со
+    // связями, поэтому порядок срабатывания после загрузки тот же.
+    // После чтения нужно вызвать RestoreBuckets
+    template <typename Archive>
+    void Serialize(Archive& archive) {
+        archive(now);
+        archive(freeHead);
+        uint32_t count = static_cast<uint32_t>(nodes.size());
+        archive.Count(count, serializedNodeBytes);
+        if (archive.IsReading()) {
+            nodes.resize(count);
+        }
+        for (auto& node : nodes) {
+            archive(node.expireTick);
+            archive(node.payload);
+            archive(node.next);
+            archive(node.prev);
+            archive(node.generation);
+            archive(node.bucket);
+            archive(node.event);
+        }
+    }
+
+    // Головы корзин по прочитанным узлам; false - связи испорчены
+    bool RestoreBuckets();
+
+private:
+    static const uint16_t freeBucket = 0xFFFF;
+    static const size_t serializedNodeBytes = 21;
+
+    struct TimerNode {
+        uint32_t expireTick;
+        uint32_t payload;
+        int32_t next;        // Следующий в корзине или в списке свободных
+        int32_t prev;        // Предыдущий в корзине (-1 - голова)
+        uint16_t generation;
+        uint16_t bucket;     // Уровень * levelSize + слот; freeBucket - узел свободен
+        TimerEvent event;
+    };
+
+    std::vector<TimerNode> nodes;
+    std::vector<TimerFired> fired;
+    int32_t heads[bucketCount];
+    int32_t freeHead;
+    uint32_t now; // Сколько тиков уже разобрано
+
+    int32_t FindIndex(TimerHandle handle) const; // -1 - таймера нет
+    void Link(int32_t index);
+    void Unlink(int32_t index);
+    void Release(int32_t index);
+    int32_t Detach(int bucket);
+};
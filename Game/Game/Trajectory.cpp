@@ -0,0 +1,37 @@
+﻿#include "Trajectory.h"
+
+Trajectory::Trajectory(size_t capacity) {
+    uint32_t size = 1;
+    while (size < capacity) size <<= 1;
+    samples.resize(size);
+    mask = size - 1;
+    empty = TrajectorySample();
+    Clear();
+}
+
+void Trajectory::Clear() {
+    head = 0;
+    count = 0;
+}
+
+void Trajectory::Reserve(size_t capacity) {
+    if (capacity <= GetCapacity()) return;
+
+    uint32_t size = GetCapacity();
+    while (size < capacity) size <<= 1;
+
+    // Переносим историю от старого к новому в начало нового кольца
+    std::vector<TrajectorySample> grown(size);
+    for (uint32_t i = 0; i < count; i++) {
+        grown[i] = samples[(head - count + i) & mask];
+    }
+    samples.swap(grown);
+    mask = size - 1;
+    head = count & mask;
+}
+
+void Trajectory::Record(const TrajectorySample& sample) {
+    samples[head] = sample;
+    head = (head + 1) & mask;
+    if (count <= mask) count++;
+}
@@ -0,0 +1,89 @@
+﻿#pragma once
+
+#include "SimMath.h"
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// История игрока по тикам: кольцевой буфер последних состояний. Компаньон
+// не повторяет за игроком по событиям и не ищет препятствия сам, а берет
+// состояние игрока delay тиков назад - то есть ровно в той точке трассы,
+// где сейчас стоит он. Память выделяется один раз в конструкторе.
+
+struct TrajectorySample {
+    Scalar x;
+    Scalar y;
+    uint8_t lane;
+    bool isJumping;
+    bool isRolling;
+};
+
+class Trajectory {
+public:
+    // capacity - сколько тиков помнить, округляется вверх до степени двойки
+    explicit Trajectory(size_t capacity = 256);
+
+    void Clear();
+
+    // Растит емкость до capacity (со степенью двойки), сохраняя историю.
+    // Меньше не становится; выделяет память, только когда растет
+    void Reserve(size_t capacity);
+
+    void Record(const TrajectorySample& sample);
+
+    // Состояние delay тиков назад (0 - последнее записанное). Если история
+    // короче, отдается самое старое; пустая история - sample по умолчанию
+    const TrajectorySample& Sample(uint32_t delay) const {
+        if (count == 0) return empty;
+        if (delay >= count) delay = count - 1;
+        return samples[(head - 1 - delay) & mask];
+    }
+
+    uint32_t GetCount() const { return count; }
+    uint32_t GetCapacity() const { return mask + 1; }
+
+    // Состояние для снимков (см. Snapshot.h). Кольцо пишется в порядке
+    // хранения, а не от старого к новому: между соседними тиками меняется
+    // один сэмпл, и дельта в буфере перемотки остается маленькой.
+    // Незаполненный хвост кольца не пишется. После чтения нужно проверить
+    // IsConsistent
+    template <typename Archive>
+    void Serialize(Archive& archive) {
+        uint32_t capacity = GetCapacity();
+        archive(capacity);
+        if (archive.IsReading() && capacity != GetCapacity() && capacity > 0 &&
+            capacity <= maxCapacity && (capacity & (capacity - 1)) == 0) {
+            // Снимок сделан с другой емкостью (другой размер толпы)
+            samples.resize(capacity);
+            mask = capacity - 1;
+        }
+        archive(head);
+        if (capacity != GetCapacity()) head = UINT32_MAX; // Испорченная емкость
+        archive.Count(count, serializedSampleBytes);
+
+        TrajectorySample skipped;
+        for (uint32_t i = 0; i < count; i++) {
+            TrajectorySample& sample = i < GetCapacity() ? samples[i] : skipped;
+            archive(sample.x);
+            archive(sample.y);
+            archive(sample.lane);
+            archive(sample.isJumping);
+            archive(sample.isRolling);
+        }
+    }
+
+    // Пока кольцо не провернулось, записи идут с нуля подряд
+    bool IsConsistent() const {
+        return count <= GetCapacity() && head <= mask && (count == GetCapacity() || head == count);
+    }
+
+private:
+    static const size_t serializedSampleBytes = 2 * sizeof(Scalar) + 3;
+    static const uint32_t maxCapacity = 1u << 16;
+
+    std::vector<TrajectorySample> samples;
+    uint32_t mask;
+    uint32_t head;  // Куда пойдет следующая запись
+    uint32_t count; // Сколько сэмплов записано (не больше емкости)
+    TrajectorySample empty;
+};